@@ -0,0 +1,210 @@
+// checkpoint.h
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "droneModel.h"
+#include "shard.h"
+#include "world.h"
+
+#define CHECKPOINT_MAGIC 0x43505241u // "ARPC"
+#define CHECKPOINT_VERSION 3
+
+// One complete copy of the simulation state; the swarm and the world of the slot are kept next to it
+// in the file (CheckpointFile.swarm and .world) so that readers of the keyboard drone copy little
+struct CheckpointSlot {
+    unsigned long long tick;
+    positionReal position[6]; // same layout as the shared memory segment, including the position history
+    int forceDirection[2]; // last command applied by droneDynamics
+    int shardCount;        // 0 for an unsharded run, which has no swarm
+    int swarmSize;
+    int droneCount[maxShards]; // drones saved for each strip, including those crossing into it
+    int worldCount;
+};
+
+// Snapshot file layout: two slots written alternately, "active" names the last complete one,
+// so a checkpoint is a plain memory write and a crash mid-write never corrupts the previous one
+struct CheckpointFile {
+    unsigned int magic;
+    unsigned int version;
+    atomic_uint active;
+    unsigned int precision; // PHYSICS_PRECISION of the writer, a snapshot is only restored with the same one
+    atomic_ullong progress; // sharded run: checkpoint epoch << 8 | shards that have finished their part
+    struct CheckpointSlot slots[2];
+    struct WorldItem world[2][worldMaxItems];
+    struct SwarmDrone swarm[2][maxShards][shardCapacity];
+};
+
+// Mapping the snapshot file for writing, creating or resetting it when needed
+struct CheckpointFile *checkpointOpen(const char *path) {
+    int fd = open(path, O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (ftruncate(fd, sizeof(struct CheckpointFile)) == -1) {
+        close(fd);
+        return NULL;
+    }
+    struct CheckpointFile *checkpoint = mmap(NULL, sizeof(struct CheckpointFile), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (checkpoint == MAP_FAILED) {
+        return NULL;
+    }
+
+    if (checkpoint->magic != CHECKPOINT_MAGIC || checkpoint->version != CHECKPOINT_VERSION ||
+        checkpoint->precision != PHYSICS_PRECISION) {
+        memset(checkpoint, 0, sizeof(struct CheckpointFile));
+        checkpoint->magic = CHECKPOINT_MAGIC;
+        checkpoint->version = CHECKPOINT_VERSION;
+        checkpoint->precision = PHYSICS_PRECISION;
+    }
+    return checkpoint;
+}
+
+// Writing the state into the inactive slot and publishing it; the kernel writes the
+// dirty page back in the background, so the physics tick never waits for the disk
+void checkpointWrite(struct CheckpointFile *checkpoint, unsigned long long tick, positionReal *position, int *forceDirection,
+                     const struct WorldItem *world, int worldCount) {
+    unsigned int next = 1 - atomic_load_explicit(&checkpoint->active, memory_order_relaxed);
+    struct CheckpointSlot *slot = &checkpoint->slots[next];
+
+    slot->tick = tick;
+    memcpy(slot->position, position, sizeof(slot->position));
+    memcpy(slot->forceDirection, forceDirection, sizeof(slot->forceDirection));
+    slot->shardCount = slot->swarmSize = 0;
+    memcpy(checkpoint->world[next], world, worldCount * sizeof(struct WorldItem));
+    slot->worldCount = worldCount;
+    atomic_store_explicit(&checkpoint->active, next, memory_order_release);
+}
+
+// Sharded run: every shard writes its own strip into the slot shard 0 chose for the epoch, and the last one
+// to finish publishes it. Shard 0 starts the epoch; anything still reporting an older one is ignored.
+void checkpointBegin(struct CheckpointFile *checkpoint, unsigned int epoch) {
+    atomic_store_explicit(&checkpoint->progress, (unsigned long long)epoch << 8, memory_order_release);
+}
+
+// Adding one drone to a shard's part of the slot; the keyboard drone also fills in the slot's own position
+void checkpointAddDrone(struct CheckpointFile *checkpoint, unsigned int slot, int shard, const struct SwarmDrone *drone) {
+    struct CheckpointSlot *state = &checkpoint->slots[slot];
+    if (state->droneCount[shard] < shardCapacity) {
+        checkpoint->swarm[slot][shard][state->droneCount[shard]++] = *drone;
+    }
+    if (drone->id == mainDroneId) {
+        memcpy(state->position, drone->position, sizeof(state->position));
+        memcpy(state->forceDirection, drone->force, sizeof(state->forceDirection));
+    }
+}
+
+// A shard's part of the epoch is complete; returns 1 if it was the last one and published the slot
+int checkpointFinish(struct CheckpointFile *checkpoint, unsigned int epoch, unsigned int slot, int shardCount) {
+    unsigned long long progress = atomic_load_explicit(&checkpoint->progress, memory_order_acquire);
+    while (progress >> 8 == epoch) {
+        if (atomic_compare_exchange_weak_explicit(&checkpoint->progress, &progress, progress + 1,
+                                                  memory_order_acq_rel, memory_order_acquire)) {
+            if ((int)(progress & 0xff) + 1 < shardCount) {
+                return 0;
+            }
+            atomic_store_explicit(&checkpoint->active, slot, memory_order_release);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Mapping the last complete checkpoint read-only, NULL if there is none; release it with checkpointUnmap
+const struct CheckpointFile *checkpointMap(const char *path, const struct CheckpointSlot **slot) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == -1 || info.st_size < (off_t)sizeof(struct CheckpointFile)) {
+        close(fd);
+        return NULL;
+    }
+    struct CheckpointFile *checkpoint = mmap(NULL, sizeof(struct CheckpointFile), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (checkpoint == MAP_FAILED) {
+        return NULL;
+    }
+
+    if (checkpoint->magic == CHECKPOINT_MAGIC && checkpoint->version == CHECKPOINT_VERSION &&
+        checkpoint->precision == PHYSICS_PRECISION) {
+        *slot = &checkpoint->slots[atomic_load_explicit(&checkpoint->active, memory_order_acquire) & 1];
+        if ((*slot)->tick > 0) {
+            return checkpoint;
+        }
+    }
+    munmap(checkpoint, sizeof(struct CheckpointFile));
+    return NULL;
+}
+
+void checkpointUnmap(const struct CheckpointFile *checkpoint) {
+    munmap((void *)checkpoint, sizeof(struct CheckpointFile));
+}
+
+// Reading the keyboard drone's part of the last complete checkpoint, returns 0 if there is none
+int checkpointRestore(const char *path, struct CheckpointSlot *state) {
+    const struct CheckpointSlot *slot;
+    const struct CheckpointFile *checkpoint = checkpointMap(path, &slot);
+    if (checkpoint == NULL) {
+        return 0;
+    }
+    *state = *slot;
+    checkpointUnmap(checkpoint);
+    return 1;
+}
+
+// Reading the obstacles and targets of the last complete checkpoint, returns -1 if there is none
+int checkpointRestoreWorld(const char *path, struct WorldItem *items) {
+    const struct CheckpointSlot *slot;
+    const struct CheckpointFile *checkpoint = checkpointMap(path, &slot);
+    if (checkpoint == NULL) {
+        return -1;
+    }
+    int count = slot->worldCount < 0 ? 0 : (slot->worldCount > worldMaxItems ? worldMaxItems : slot->worldCount);
+    memcpy(items, checkpoint->world[slot - checkpoint->slots], count * sizeof(struct WorldItem));
+    checkpointUnmap(checkpoint);
+    return count;
+}
+
+// Putting the swarm of the last complete checkpoint on a freshly created board (shardCreate), every drone
+// in the strip it was in, which may differ when the number of shards changed. Returns the tick of the
+// checkpoint, 0 if it holds no swarm of this size (unsharded run, other -N), and the board is left as created.
+unsigned long long checkpointRestoreSwarm(const char *path, struct ShardSegment *segment) {
+    const struct CheckpointSlot *slot;
+    const struct CheckpointFile *checkpoint = checkpointMap(path, &slot);
+    if (checkpoint == NULL) {
+        return 0;
+    }
+    unsigned long long tick = 0;
+    if (slot->shardCount > 0 && slot->shardCount <= maxShards && slot->swarmSize == segment->swarmSize) {
+        tick = slot->tick;
+        for (int shard = 0; shard < segment->shardCount; shard++) {
+            atomic_store(&segment->regions[shard].count, 0);
+            atomic_store(&segment->regions[shard].reserved, 0);
+        }
+        const struct SwarmDrone (*swarm)[shardCapacity] = checkpoint->swarm[slot - checkpoint->slots];
+        for (int shard = 0; shard < slot->shardCount; shard++) {
+            for (int i = 0; i < slot->droneCount[shard] && i < shardCapacity; i++) {
+                shardPlace(segment, &swarm[shard][i]);
+                if (swarm[shard][i].id == mainDroneId) {
+                    atomic_store(&segment->mainPlaced, 1);
+                    atomic_store(&segment->mainStarted, 1);
+                }
+            }
+        }
+        atomic_store(&segment->forceDirection[0], slot->forceDirection[0]);
+        atomic_store(&segment->forceDirection[1], slot->forceDirection[1]);
+        atomic_store(&segment->tick, tick);
+    }
+    checkpointUnmap(checkpoint);
+    return tick;
+}
+
+#endif
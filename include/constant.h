@@ -7,7 +7,7 @@
 
 #define SEM_PATH "/sem_path"
 #define SHM_PATH "/shm_path"
-#define SHM_SIZE sizeof(struct Position)
+#define SHM_SIZE sizeof(struct SharedState) // sharedState.h
 
 #define M 1.0
 #define K 1.0
@@ -18,6 +18,42 @@
 
 #define counterThresold 5
 
+#define maxRestarts 5        // restarts of one component allowed within restartWindow before giving up
+#define restartWindow 10     // seconds
+#define recoveryBudgetMs 100
+
+#define CHECKPOINT_PATH "simulation.ckpt"
+#define checkpointInterval 10 // physics ticks between checkpoints
+
+#define droneTickUs 300000
+
+// Consumers block on the state generation (sharedState.h) instead of sleeping; each keeps a rate cap
+#define serverLogIntervalUs 1000000 // at most one server log line per second
+#define windowFrameIntervalUs 50000 // at most 20 frames per second
+#define windowKeyPollUs 100000      // longest wait for a new state before the window checks for keys
+#define stateWaitTimeoutUs 1000000  // upper bound on any wait, so a stalled writer is still noticed
+
+// Real-time profile (./bin/master -R): core and priority per process in launch order
+// (Server, Window, KeyboardManager, DroneDynamics, Watchdog), -1 / 0 keep the defaults;
+// shard k of a sharded board (-n) runs on DroneDynamics' core + k
+#define rtPolicy SCHED_FIFO
+#define rtCores {-1, -1, 1, 2, -1}
+#define rtPriorities {0, 0, 40, 50, 0}
+#define rtStackPrefault (64 * 1024)
+#define rtFlushInterval 50     // log lines buffered between flushes on the hot paths
+#define jitterReportInterval 100
+
+// Autopilot (./bin/master -a mission.txt)
+#define plannerResolution 2    // planner cells per board unit
+#define autopilotMaxForce 4    // largest force component sent, as after four key presses
+#define autopilotCruise 1.0    // board units per tick
+#define autopilotTolerance 1.0 // distance at which a waypoint counts as reached
+
+// Virtual clock (./bin/master -l -v): the watchdog's 50 ms pauses follow simulated time, but last at least this long
+#define watchdogMinPauseUs 5000
+
+#define profileInterval 100 // ticks or frames per perf summary (make PROFILE=1)
+
 #define windowWidth 1.00
 #define scoreboardWinHeight 0.20
 #define windowHeight 0.80
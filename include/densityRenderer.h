@@ -0,0 +1,117 @@
+// densityRenderer.h
+#ifndef DENSITY_RENDERER_H
+#define DENSITY_RENDERER_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <curses.h>
+#include "droneModel.h"
+
+// First color pair used for the density levels (pairs 1 and 2 belong to the window)
+#define DENSITY_COLOR_PAIR 3
+#define densityLevels 4
+
+// Per-cell drone counts of the current and the previously drawn frame; only the cells whose
+// count changed are sent to ncurses, so a frame costs O(rows * cols) whatever the swarm size
+struct DensityRenderer {
+    int rows, cols;            // drawable area, the border rows/columns are excluded
+    double scalex, scaley;     // board units per terminal cell
+    unsigned short *current;
+    unsigned short *previous;
+};
+
+// Glyph and color for each density level: 1 drone, 2-3, 4-7, 8 and more. None of them is a glyph of the
+// world ('#' obstacle, 'X' target, see drawWorld) or of the border, so a crowd never looks like a wall.
+static const char densityGlyphs[densityLevels] = {'+', '*', 'o', '@'};
+
+void densityColors() {
+    init_pair(DENSITY_COLOR_PAIR + 0, COLOR_BLUE, COLOR_BLACK);
+    init_pair(DENSITY_COLOR_PAIR + 1, COLOR_CYAN, COLOR_BLACK);
+    init_pair(DENSITY_COLOR_PAIR + 2, COLOR_YELLOW, COLOR_BLACK);
+    init_pair(DENSITY_COLOR_PAIR + 3, COLOR_RED, COLOR_BLACK);
+}
+
+int densityLevel(unsigned short count) {
+    int level = 0;
+    while (count > 1 && level < densityLevels - 1) {
+        count >>= 1;
+        level++;
+    }
+    return level;
+}
+
+// Allocating the buffers for a board of rows x cols cells; returns -1 on failure
+int densityInit(struct DensityRenderer *renderer, int rows, int cols, double scalex, double scaley) {
+    renderer->rows = rows > 0 ? rows : 1;
+    renderer->cols = cols > 0 ? cols : 1;
+    renderer->scalex = scalex;
+    renderer->scaley = scaley;
+    size_t cells = (size_t)renderer->rows * renderer->cols;
+    renderer->current = calloc(cells, sizeof(unsigned short));
+    renderer->previous = calloc(cells, sizeof(unsigned short));
+    if (renderer->current == NULL || renderer->previous == NULL) {
+        free(renderer->current);
+        free(renderer->previous);
+        return -1;
+    }
+    return 0;
+}
+
+void densityFree(struct DensityRenderer *renderer) {
+    free(renderer->current);
+    free(renderer->previous);
+    renderer->current = renderer->previous = NULL;
+}
+
+void densityClear(struct DensityRenderer *renderer) {
+    memset(renderer->current, 0, (size_t)renderer->rows * renderer->cols * sizeof(unsigned short));
+}
+
+// Adding count drones to the frame: (x, y) of drone i is at state[i * stride], state[i * stride + 1]
+void densityAdd(struct DensityRenderer *renderer, const positionReal *state, int count, int stride) {
+    for (int i = 0; i < count; i++) {
+        int col = (int)(positionToDouble(state[i * stride]) / renderer->scalex) - 1;
+        int row = (int)(positionToDouble(state[i * stride + 1]) / renderer->scaley) - 1;
+        col = col < 0 ? 0 : (col >= renderer->cols ? renderer->cols - 1 : col);
+        row = row < 0 ? 0 : (row >= renderer->rows ? renderer->rows - 1 : row);
+
+        unsigned short *cell = &renderer->current[row * renderer->cols + col];
+        if (*cell < 0xFFFF) {
+            (*cell)++;
+        }
+    }
+}
+
+// One linear pass over the published state
+void densityRasterize(struct DensityRenderer *renderer, const positionReal *state, int count, int stride) {
+    densityClear(renderer);
+    densityAdd(renderer, state, count, stride);
+}
+
+// Drawing the cells that differ from the previous frame (offset by one for the border), returns how many were drawn
+int densityPresent(struct DensityRenderer *renderer, WINDOW *win) {
+    int drawn = 0;
+    for (int row = 0; row < renderer->rows; row++) {
+        unsigned short *current = &renderer->current[row * renderer->cols];
+        unsigned short *previous = &renderer->previous[row * renderer->cols];
+        for (int col = 0; col < renderer->cols; col++) {
+            if (current[col] == previous[col]) {
+                continue;
+            }
+            if (current[col] == 0) {
+                mvwaddch(win, row + 1, col + 1, ' ');
+            } else {
+                int level = densityLevel(current[col]);
+                mvwaddch(win, row + 1, col + 1, densityGlyphs[level] | COLOR_PAIR(DENSITY_COLOR_PAIR + level));
+            }
+            drawn++;
+        }
+    }
+
+    unsigned short *swap = renderer->previous;
+    renderer->previous = renderer->current;
+    renderer->current = swap;
+    return drawn;
+}
+
+#endif
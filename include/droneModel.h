@@ -0,0 +1,155 @@
+// droneModel.h
+#ifndef DRONE_MODEL_H
+#define DRONE_MODEL_H
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+// Numeric representation of the drone state, selected at compile time (make PRECISION=FLOAT)
+#define PRECISION_DOUBLE 0
+#define PRECISION_FLOAT 1
+#define PRECISION_FIXED 2
+
+#ifndef PHYSICS_PRECISION
+#define PHYSICS_PRECISION PRECISION_DOUBLE
+#endif
+
+// Q16.16 fixed point: the board is 0..boardSize, so 15 integer bits leave plenty of headroom
+typedef int32_t fixed_t;
+#define FIXED_SHIFT 16
+#define FIXED_ONE (1 << FIXED_SHIFT)
+#define toFixed(x) ((fixed_t)lrint((x) * FIXED_ONE))
+#define fromFixed(x) ((double)(x) / FIXED_ONE)
+
+// Function for computing new position using Euler's Method
+double computePositionDouble(double force, double x1, double x2) {
+    double newPosition = x1 + (force * T) - ((M * (x1 - x2)) / (M + K * T));
+    return newPosition;
+}
+
+float computePositionFloat(float force, float x1, float x2) {
+    float newPosition = x1 + (force * (float)T) - (((float)M * (x1 - x2)) / (float)(M + K * T));
+    return newPosition;
+}
+
+// Same step with the constant factors folded into fixed-point coefficients
+fixed_t computePositionFixed(int force, fixed_t x1, fixed_t x2) {
+    const int64_t step = toFixed(T);
+    const int64_t damping = toFixed(M / (M + K * T));
+    int64_t velocityTerm = ((int64_t)(x1 - x2) * damping + FIXED_ONE / 2) >> FIXED_SHIFT;
+    return (fixed_t)(x1 + force * step - velocityTerm);
+}
+
+// Functions to update the drone's position based on force direction; position holds
+// the initial, previous and current (x, y) pairs, as published in shared memory
+double updatePositionDouble(double *position, int *forceDirection) {
+    double newPositionX = computePositionDouble(forceDirection[0], position[4], position[2]);
+    double newPositionY = computePositionDouble(forceDirection[1], position[5], position[3]);
+
+    // Boundary conditions
+    newPositionX = fmax(0, fmin(newPositionX, boardSize));
+    newPositionY = fmax(0, fmin(newPositionY, boardSize));
+
+    // Updating position array
+    memmove(position, position + 2, 4 * sizeof(double));
+    position[4] = newPositionX;
+    position[5] = newPositionY;
+
+    return *position;
+}
+
+float updatePositionFloat(float *position, int *forceDirection) {
+    float newPositionX = computePositionFloat(forceDirection[0], position[4], position[2]);
+    float newPositionY = computePositionFloat(forceDirection[1], position[5], position[3]);
+
+    newPositionX = fmaxf(0, fminf(newPositionX, boardSize));
+    newPositionY = fmaxf(0, fminf(newPositionY, boardSize));
+
+    memmove(position, position + 2, 4 * sizeof(float));
+    position[4] = newPositionX;
+    position[5] = newPositionY;
+
+    return *position;
+}
+
+fixed_t updatePositionFixed(fixed_t *position, int *forceDirection) {
+    const fixed_t limit = boardSize * FIXED_ONE;
+    fixed_t newPositionX = computePositionFixed(forceDirection[0], position[4], position[2]);
+    fixed_t newPositionY = computePositionFixed(forceDirection[1], position[5], position[3]);
+
+    newPositionX = newPositionX < 0 ? 0 : (newPositionX > limit ? limit : newPositionX);
+    newPositionY = newPositionY < 0 ? 0 : (newPositionY > limit ? limit : newPositionY);
+
+    memmove(position, position + 2, 4 * sizeof(fixed_t));
+    position[4] = newPositionX;
+    position[5] = newPositionY;
+
+    return *position;
+}
+
+// Keys the drone is steered with and the change each one makes to the force: a unit step in one of eight
+// directions, or 'd', which stops the drone. keyboardManager applies the keys it receives, the load
+// generator, the benchmarks and the swarm draw keys from this table.
+static const char movementKeys[] = "srexdcwfv";
+static const int movementKeySteps[][2] = {{-1, 0}, {1, -1}, {0, -1}, {-1, 1}, {0, 0}, {0, 1}, {-1, -1}, {1, 0}, {1, 1}};
+#define movementKeyCount ((int)(sizeof(movementKeys) - 1))
+
+void applyMovementKey(int index, int *force) {
+    if (movementKeys[index] == 'd') {
+        force[0] = force[1] = 0;
+        return;
+    }
+    force[0] += movementKeySteps[index][0];
+    force[1] += movementKeySteps[index][1];
+}
+
+// Same for a key received as a character; returns 0, leaving force as it was, if it is no movement key
+int applyKey(char key, int *force) {
+    const char *found = key != '\0' ? strchr(movementKeys, key) : NULL;
+    if (found == NULL) {
+        return 0;
+    }
+    applyMovementKey(found - movementKeys, force);
+    return 1;
+}
+
+// Model constants as runtime values, for sweeping M, K and T without rebuilding
+struct ModelParams {
+    double mass;      // M
+    double stiffness; // K
+    double step;      // T
+};
+
+// Same step as computePositionDouble with the constants taken from params; the damping factor
+// M / (M + K * T) is precomputed by the caller since it only depends on the parameters
+double computePositionParams(const struct ModelParams *params, double damping, double force, double x1, double x2) {
+    return x1 + force * params->step - damping * (x1 - x2);
+}
+
+double modelDamping(const struct ModelParams *params) {
+    return params->mass / (params->mass + params->stiffness * params->step);
+}
+
+// The representation used by the running simulation, including the shared memory segment
+#if PHYSICS_PRECISION == PRECISION_FLOAT
+typedef float positionReal;
+#define computePosition computePositionFloat
+#define updatePosition updatePositionFloat
+#define positionToDouble(x) ((double)(x))
+#define positionFromDouble(x) ((float)(x))
+#elif PHYSICS_PRECISION == PRECISION_FIXED
+typedef fixed_t positionReal;
+#define computePosition computePositionFixed
+#define updatePosition updatePositionFixed
+#define positionToDouble(x) fromFixed(x)
+#define positionFromDouble(x) toFixed(x)
+#else
+typedef double positionReal;
+#define computePosition computePositionDouble
+#define updatePosition updatePositionDouble
+#define positionToDouble(x) ((double)(x))
+#define positionFromDouble(x) ((double)(x))
+#endif
+
+#endif
@@ -0,0 +1,288 @@
+// dstarLite.h
+#ifndef DSTAR_LITE_H
+#define DSTAR_LITE_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Incremental path planning on an 8-connected grid with D* Lite (Koenig & Likhachev).
+// The search runs from the goal towards the drone, so when the drone moves or a few cells
+// change only the vertices whose distance actually changed are expanded again.
+
+struct DStarKey {
+    float primary;
+    float secondary;
+};
+
+struct DStarLite {
+    int width, height;
+    float *g;
+    float *rhs;
+    unsigned char *blocked;
+    int *heap;              // open list: binary heap of vertex indices
+    int *heapIndex;         // position of each vertex in the heap, -1 when not queued
+    struct DStarKey *keys;  // key each queued vertex was inserted with
+    int heapSize;
+    int start, goal, last;
+    float km;
+    unsigned long expanded; // vertices expanded by the last computeShortestPath
+};
+
+static const int dstarDx[8] = {1, -1, 0, 0, 1, 1, -1, -1};
+static const int dstarDy[8] = {0, 0, 1, -1, 1, -1, 1, -1};
+
+float dstarHeuristic(struct DStarLite *planner, int a, int b) {
+    // Octile distance, consistent with the 1 / sqrt(2) move costs
+    float dx = fabsf((float)(a % planner->width - b % planner->width));
+    float dy = fabsf((float)(a / planner->width - b / planner->width));
+    return fmaxf(dx, dy) + ((float)M_SQRT2 - 1.0f) * fminf(dx, dy);
+}
+
+float dstarCost(struct DStarLite *planner, int a, int b, int direction) {
+    if (planner->blocked[a] || planner->blocked[b]) {
+        return INFINITY;
+    }
+    if (direction < 4) {
+        return 1.0f;
+    }
+    // A diagonal step must not cut the corner of a blocked cell: both orthogonal cells it passes must be free
+    if (planner->blocked[a + dstarDx[direction]] || planner->blocked[a + dstarDy[direction] * planner->width]) {
+        return INFINITY;
+    }
+    return (float)M_SQRT2;
+}
+
+// Index of the neighbour in the given direction, -1 outside the grid
+int dstarNeighbour(struct DStarLite *planner, int vertex, int direction) {
+    int x = vertex % planner->width + dstarDx[direction];
+    int y = vertex / planner->width + dstarDy[direction];
+    if (x < 0 || y < 0 || x >= planner->width || y >= planner->height) {
+        return -1;
+    }
+    return y * planner->width + x;
+}
+
+struct DStarKey dstarCalculateKey(struct DStarLite *planner, int vertex) {
+    float best = fminf(planner->g[vertex], planner->rhs[vertex]);
+    struct DStarKey key = {best + dstarHeuristic(planner, planner->start, vertex) + planner->km, best};
+    return key;
+}
+
+int dstarKeyLess(struct DStarKey a, struct DStarKey b) {
+    return a.primary < b.primary || (a.primary == b.primary && a.secondary < b.secondary);
+}
+
+// ---------------------------------------------------------------- open list
+
+void dstarHeapSwap(struct DStarLite *planner, int i, int j) {
+    int a = planner->heap[i], b = planner->heap[j];
+    planner->heap[i] = b;
+    planner->heap[j] = a;
+    planner->heapIndex[b] = i;
+    planner->heapIndex[a] = j;
+}
+
+void dstarHeapUp(struct DStarLite *planner, int i) {
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!dstarKeyLess(planner->keys[planner->heap[i]], planner->keys[planner->heap[parent]])) {
+            break;
+        }
+        dstarHeapSwap(planner, i, parent);
+        i = parent;
+    }
+}
+
+void dstarHeapDown(struct DStarLite *planner, int i) {
+    while (1) {
+        int smallest = i, left = 2 * i + 1, right = 2 * i + 2;
+        if (left < planner->heapSize && dstarKeyLess(planner->keys[planner->heap[left]], planner->keys[planner->heap[smallest]])) {
+            smallest = left;
+        }
+        if (right < planner->heapSize && dstarKeyLess(planner->keys[planner->heap[right]], planner->keys[planner->heap[smallest]])) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            break;
+        }
+        dstarHeapSwap(planner, i, smallest);
+        i = smallest;
+    }
+}
+
+// Inserting a vertex, or moving it if it is already queued
+void dstarHeapPush(struct DStarLite *planner, int vertex, struct DStarKey key) {
+    planner->keys[vertex] = key;
+    int i = planner->heapIndex[vertex];
+    if (i < 0) {
+        i = planner->heapSize++;
+        planner->heap[i] = vertex;
+        planner->heapIndex[vertex] = i;
+    }
+    dstarHeapUp(planner, i);
+    dstarHeapDown(planner, planner->heapIndex[vertex]);
+}
+
+void dstarHeapRemove(struct DStarLite *planner, int vertex) {
+    int i = planner->heapIndex[vertex];
+    if (i < 0) {
+        return;
+    }
+    int lastSlot = --planner->heapSize;
+    if (i != lastSlot) {
+        int moved = planner->heap[lastSlot];
+        dstarHeapSwap(planner, i, lastSlot);
+        dstarHeapUp(planner, i);
+        dstarHeapDown(planner, planner->heapIndex[moved]);
+    }
+    planner->heapIndex[vertex] = -1;
+}
+
+// ---------------------------------------------------------------- D* Lite
+
+void dstarUpdateVertex(struct DStarLite *planner, int vertex) {
+    if (vertex != planner->goal) {
+        float best = INFINITY;
+        for (int d = 0; d < 8; d++) {
+            int next = dstarNeighbour(planner, vertex, d);
+            if (next >= 0) {
+                best = fminf(best, dstarCost(planner, vertex, next, d) + planner->g[next]);
+            }
+        }
+        planner->rhs[vertex] = best;
+    }
+    if (planner->g[vertex] != planner->rhs[vertex]) {
+        dstarHeapPush(planner, vertex, dstarCalculateKey(planner, vertex));
+    } else {
+        dstarHeapRemove(planner, vertex);
+    }
+}
+
+// Expanding vertices until the drone's cell is consistent; returns 0 when the goal is unreachable
+int dstarComputePath(struct DStarLite *planner) {
+    planner->expanded = 0;
+    while (planner->heapSize > 0 &&
+           (dstarKeyLess(planner->keys[planner->heap[0]], dstarCalculateKey(planner, planner->start)) ||
+            planner->rhs[planner->start] != planner->g[planner->start])) {
+        int vertex = planner->heap[0];
+        struct DStarKey oldKey = planner->keys[vertex];
+        struct DStarKey newKey = dstarCalculateKey(planner, vertex);
+        planner->expanded++;
+
+        if (dstarKeyLess(oldKey, newKey)) {
+            dstarHeapPush(planner, vertex, newKey);
+        } else if (planner->g[vertex] > planner->rhs[vertex]) {
+            planner->g[vertex] = planner->rhs[vertex];
+            dstarHeapRemove(planner, vertex);
+            for (int d = 0; d < 8; d++) {
+                int previous = dstarNeighbour(planner, vertex, d);
+                if (previous >= 0) {
+                    dstarUpdateVertex(planner, previous);
+                }
+            }
+        } else {
+            planner->g[vertex] = INFINITY;
+            dstarUpdateVertex(planner, vertex);
+            for (int d = 0; d < 8; d++) {
+                int previous = dstarNeighbour(planner, vertex, d);
+                if (previous >= 0) {
+                    dstarUpdateVertex(planner, previous);
+                }
+            }
+        }
+    }
+    return !isinf(planner->g[planner->start]);
+}
+
+// Allocating a planner for a width x height grid; returns -1 on failure
+int dstarInit(struct DStarLite *planner, int width, int height) {
+    size_t cells = (size_t)width * height;
+    memset(planner, 0, sizeof(*planner));
+    planner->width = width;
+    planner->height = height;
+    planner->g = malloc(cells * sizeof(float));
+    planner->rhs = malloc(cells * sizeof(float));
+    planner->blocked = calloc(cells, 1);
+    planner->heap = malloc(cells * sizeof(int));
+    planner->heapIndex = malloc(cells * sizeof(int));
+    planner->keys = malloc(cells * sizeof(struct DStarKey));
+    if (!planner->g || !planner->rhs || !planner->blocked || !planner->heap || !planner->heapIndex || !planner->keys) {
+        return -1;
+    }
+    planner->goal = planner->start = planner->last = -1;
+    return 0;
+}
+
+void dstarFree(struct DStarLite *planner) {
+    free(planner->g);
+    free(planner->rhs);
+    free(planner->blocked);
+    free(planner->heap);
+    free(planner->heapIndex);
+    free(planner->keys);
+}
+
+// A new goal invalidates every distance, so the search restarts from scratch
+void dstarSetGoal(struct DStarLite *planner, int start, int goal) {
+    size_t cells = (size_t)planner->width * planner->height;
+    for (size_t i = 0; i < cells; i++) {
+        planner->g[i] = INFINITY;
+        planner->rhs[i] = INFINITY;
+        planner->heapIndex[i] = -1;
+    }
+    planner->heapSize = 0;
+    planner->km = 0;
+    planner->start = planner->last = start;
+    planner->goal = goal;
+    planner->rhs[goal] = 0;
+    dstarHeapPush(planner, goal, dstarCalculateKey(planner, goal));
+}
+
+// The drone moved: only the key modifier changes, queued keys stay valid lower bounds
+void dstarMoveStart(struct DStarLite *planner, int start) {
+    if (start == planner->start) {
+        return;
+    }
+    planner->start = start;
+    planner->km += dstarHeuristic(planner, planner->last, start);
+    planner->last = start;
+}
+
+// A cell became blocked or free: repairing only the vertices whose edge costs changed, which are its
+// neighbours, including the ends of the diagonals passing its corner
+void dstarSetBlocked(struct DStarLite *planner, int vertex, int blocked) {
+    if (planner->blocked[vertex] == blocked) {
+        return;
+    }
+    planner->blocked[vertex] = blocked;
+    if (planner->goal < 0) {
+        return;
+    }
+    dstarUpdateVertex(planner, vertex);
+    for (int d = 0; d < 8; d++) {
+        int neighbour = dstarNeighbour(planner, vertex, d);
+        if (neighbour >= 0) {
+            dstarUpdateVertex(planner, neighbour);
+        }
+    }
+}
+
+// Next cell on the current shortest path from the drone, -1 if there is none
+int dstarNextStep(struct DStarLite *planner) {
+    int bestVertex = -1;
+    float best = INFINITY;
+    for (int d = 0; d < 8; d++) {
+        int next = dstarNeighbour(planner, planner->start, d);
+        if (next >= 0) {
+            float cost = dstarCost(planner, planner->start, next, d) + planner->g[next];
+            if (cost < best) {
+                best = cost;
+                bestVertex = next;
+            }
+        }
+    }
+    return bestVertex;
+}
+
+#endif
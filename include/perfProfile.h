@@ -0,0 +1,175 @@
+// perfProfile.h
+#ifndef PERF_PROFILE_H
+#define PERF_PROFILE_H
+
+// Hardware-counter profiling of a hot region (make PROFILE=1). Without PERF_PROFILE the macros
+// below expand to nothing, so the instrumented code is identical to an uninstrumented build.
+#ifdef PERF_PROFILE
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define perfCounters 4
+
+static const char *perfCounterNames[perfCounters] = {"cycles", "instructions", "cacheMisses", "contextSwitches"};
+
+struct PerfProfile {
+    const char *component;
+    const char *region;
+    int fds[perfCounters];           // -1 when the counter is not available on this host
+    int slots[perfCounters];         // position of the counter's value in a group read
+    int leader;                      // first counter opened; one read() of it returns the whole group
+    uint64_t start[perfCounters];
+    uint64_t intervalSum[perfCounters];
+    double beginUs;
+    double intervalUs;
+    unsigned long ticks;
+    FILE *logFile;                   // per-interval summaries
+    FILE *trace;                     // Chrome trace events (chrome://tracing, Perfetto)
+    FILE *folded;                    // folded stacks for flamegraph.pl
+};
+
+// Kernel time is only left out of the hardware counters: a context switch is counted in the kernel
+int perfOpenCounter(uint32_t type, uint64_t config, int groupFd) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = type == PERF_TYPE_HARDWARE;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0);
+}
+
+double perfNowUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// All counters in one read() of the group leader; unavailable counters read as 0
+void perfRead(struct PerfProfile *profile, uint64_t values[perfCounters]) {
+    uint64_t group[1 + perfCounters]; // number of counters, then their values in the order they joined
+    memset(values, 0, perfCounters * sizeof(uint64_t));
+    if (profile->leader < 0 || read(profile->leader, group, sizeof(group)) < (ssize_t)sizeof(group[0])) {
+        return;
+    }
+    for (int i = 0; i < perfCounters; i++) {
+        if (profile->fds[i] >= 0 && (uint64_t)profile->slots[i] < group[0]) {
+            values[i] = group[1 + profile->slots[i]];
+        }
+    }
+}
+
+void perfOpen(struct PerfProfile *profile, FILE *logFile, const char *component, const char *region) {
+    memset(profile, 0, sizeof(*profile));
+    profile->component = component;
+    profile->region = region;
+    profile->logFile = logFile;
+
+    static const uint32_t types[perfCounters] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_SOFTWARE};
+    static const uint64_t configs[perfCounters] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                   PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_SW_CONTEXT_SWITCHES};
+    profile->leader = -1;
+    int grouped = 0;
+    for (int i = 0; i < perfCounters; i++) {
+        profile->fds[i] = perfOpenCounter(types[i], configs[i], profile->leader);
+        if (profile->fds[i] < 0) {
+            fprintf(logFile, "perf: %s counter not available\n", perfCounterNames[i]);
+            continue;
+        }
+        if (profile->leader < 0) {
+            profile->leader = profile->fds[i];
+        }
+        profile->slots[i] = grouped++;
+    }
+
+    char path[100];
+    snprintf(path, sizeof(path), "log/perf_%s.json", component);
+    profile->trace = fopen(path, "w");
+    if (profile->trace != NULL) {
+        fprintf(profile->trace, "[\n"); // the closing bracket is optional in the trace event format
+    }
+    snprintf(path, sizeof(path), "log/perf_%s.folded", component);
+    profile->folded = fopen(path, "w");
+    fflush(logFile);
+}
+
+void perfBegin(struct PerfProfile *profile) {
+    perfRead(profile, profile->start);
+    profile->beginUs = perfNowUs();
+}
+
+void perfEnd(struct PerfProfile *profile) {
+    double endUs = perfNowUs();
+    uint64_t delta[perfCounters];
+    perfRead(profile, delta);
+    for (int i = 0; i < perfCounters; i++) {
+        delta[i] -= profile->start[i];
+        profile->intervalSum[i] += delta[i];
+    }
+    profile->intervalUs += endUs - profile->beginUs;
+    profile->ticks++;
+
+    if (profile->trace != NULL) {
+        fprintf(profile->trace, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+                "\"args\":{\"cycles\":%llu,\"instructions\":%llu,\"cacheMisses\":%llu,\"contextSwitches\":%llu}},\n",
+                profile->region, getpid(), getpid(), profile->beginUs, endUs - profile->beginUs,
+                (unsigned long long)delta[0], (unsigned long long)delta[1],
+                (unsigned long long)delta[2], (unsigned long long)delta[3]);
+    }
+
+    if (profile->ticks % profileInterval != 0) {
+        return;
+    }
+
+    // Interval summary: averages per tick in the component log, counter tracks in the trace
+    double n = profile->ticks;
+    uint64_t *sum = profile->intervalSum;
+    fprintf(profile->logFile, "Perf %s over %lu ticks: %.1f us, %.0f cycles, %.0f instructions (IPC %.2f), "
+            "%.1f cache misses, %.2f context switches per tick\n",
+            profile->region, profile->ticks, profile->intervalUs / n, sum[0] / n, sum[1] / n,
+            sum[0] ? (double)sum[1] / sum[0] : 0.0, sum[2] / n, sum[3] / n);
+    fflush(profile->logFile);
+
+    if (profile->trace != NULL) {
+        for (int i = 0; i < perfCounters; i++) {
+            fprintf(profile->trace, "{\"name\":\"%s per tick\",\"ph\":\"C\",\"pid\":%d,\"ts\":%.3f,\"args\":{\"%s\":%.1f}},\n",
+                    perfCounterNames[i], getpid(), endUs, perfCounterNames[i], sum[i] / n);
+        }
+        fflush(profile->trace);
+    }
+    if (profile->folded != NULL) {
+        // Weighted by cycles, or by nanoseconds on hosts without hardware counters
+        uint64_t weight = profile->fds[0] >= 0 ? sum[0] : (uint64_t)(profile->intervalUs * 1000);
+        fprintf(profile->folded, "%s;%s %llu\n", profile->component, profile->region, (unsigned long long)weight);
+        fflush(profile->folded);
+    }
+
+    memset(profile->intervalSum, 0, sizeof(profile->intervalSum));
+    profile->intervalUs = 0;
+    profile->ticks = 0;
+}
+
+#define PROFILE_DECLARE(profile) struct PerfProfile profile
+#define PROFILE_OPEN(profile, logFile, component, region) perfOpen(&(profile), logFile, component, region)
+#define PROFILE_BEGIN(profile) perfBegin(&(profile))
+#define PROFILE_END(profile) perfEnd(&(profile))
+
+#else
+
+#define PROFILE_DECLARE(profile)
+#define PROFILE_OPEN(profile, logFile, component, region)
+#define PROFILE_BEGIN(profile)
+#define PROFILE_END(profile)
+
+#endif
+
+#endif
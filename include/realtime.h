@@ -0,0 +1,122 @@
+// realtime.h
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// Core of a process in the real-time profile, -1 for no pinning; the shards of droneDynamics take
+// consecutive cores from its entry on, and cores wrap around the online CPUs
+int realtimeCore(int process, int shard) {
+    int cores[numberOfProcesses] = rtCores;
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores[process] < 0 || online <= 0) {
+        return -1;
+    }
+    return (cores[process] + shard) % online;
+}
+
+// Scheduling part of the real-time profile, applied by master in the child before exec
+// (policy, priority and affinity are inherited across exec)
+void applyRealtimeScheduling(int process, int shard, const char *name) {
+    int priorities[numberOfProcesses] = rtPriorities;
+    int core = realtimeCore(process, shard);
+
+    if (core >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(core, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) == -1) {
+            fprintf(stderr, "%s: sched_setaffinity: %s\n", name, strerror(errno));
+        }
+    }
+
+    if (priorities[process] > 0) {
+        struct sched_param param = {.sched_priority = priorities[process]};
+        if (sched_setscheduler(0, rtPolicy, &param) == -1) {
+            fprintf(stderr, "%s: real-time priority not permitted (%s), keeping the default scheduler\n", name, strerror(errno));
+        }
+    }
+}
+
+// Memory part of the profile, done by the component itself since locks do not survive exec:
+// lock every current and future page, then touch the shared segment and some stack so the
+// hot path never takes a page fault
+void applyRealtimeMemory(FILE *logFile, void *shared, size_t sharedSize) {
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) == -1) {
+        fprintf(logFile, "mlockall failed: %s\n", strerror(errno));
+    }
+
+    long pageSize = sysconf(_SC_PAGESIZE);
+    volatile char *bytes = shared;
+    for (size_t offset = 0; offset < sharedSize; offset += pageSize) {
+        bytes[offset] = bytes[offset];
+    }
+
+    volatile char stack[rtStackPrefault];
+    for (size_t offset = 0; offset < sizeof(stack); offset += pageSize) {
+        stack[offset] = 0;
+    }
+}
+
+// Wake-up lateness of a periodic loop, in microseconds
+struct JitterStats {
+    unsigned long count;
+    double sum;
+    double max;
+    unsigned long histogram[1000]; // 10 us buckets, the last one collects everything above 10 ms
+};
+
+void jitterRecord(struct JitterStats *stats, double lateUs) {
+    if (lateUs < 0) {
+        lateUs = 0;
+    }
+    stats->count++;
+    stats->sum += lateUs;
+    if (lateUs > stats->max) {
+        stats->max = lateUs;
+    }
+    int bucket = lateUs >= 9990 ? 999 : (int)(lateUs / 10);
+    stats->histogram[bucket]++;
+}
+
+// Logging a summary of the interval and starting a new one
+void jitterReport(struct JitterStats *stats, FILE *logFile, int realtime) {
+    if (stats->count == 0) {
+        return;
+    }
+    unsigned long target = (unsigned long)(stats->count * 0.99), seen = 0;
+    int p99 = 0;
+    while (p99 < 999 && seen + stats->histogram[p99] <= target) {
+        seen += stats->histogram[p99++];
+    }
+    fprintf(logFile, "Tick jitter (realtime %s): mean %.1f us, p99 %s%d us, max %.1f us over %lu ticks\n",
+            realtime ? "on" : "off", stats->sum / stats->count, p99 == 999 ? ">" : "<", (p99 + 1) * 10, stats->max, stats->count);
+    fflush(logFile);
+    memset(stats, 0, sizeof(*stats));
+}
+
+// Sleeping until an absolute CLOCK_MONOTONIC deadline, resuming after signals (the watchdog pings every
+// component), and returning how late the wake-up was in microseconds
+double sleepUntil(struct timespec *deadline) {
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, deadline, NULL) == EINTR) {
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - deadline->tv_sec) * 1e6 + (now.tv_nsec - deadline->tv_nsec) / 1e3;
+}
+
+void advanceDeadline(struct timespec *deadline, long periodUs) {
+    deadline->tv_nsec += periodUs * 1000L;
+    while (deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_nsec -= 1000000000L;
+        deadline->tv_sec++;
+    }
+}
+
+#endif
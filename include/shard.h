@@ -0,0 +1,256 @@
+// shard.h
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "droneModel.h"
+
+// Spatial sharding (./bin/master -n shards): the board is cut into vertical strips of equal width and
+// every strip is simulated by its own droneDynamics process. All shards share one segment that holds
+// each shard's drones, the queues through which drones cross a strip boundary and the ghost tables
+// that let a shard see its neighbours' drones near the edge.
+
+#define SHARD_SHM_PATH "/shard_shm"
+#define maxShards 8
+#define shardCapacity 4096     // drones one shard can own
+#define migrationCapacity 1024 // drones in flight towards one neighbour
+#define ghostCapacity 1024     // drones near one edge visible to the neighbour
+#define ghostReadRetries 100   // attempts to read a neighbour's ghost table before doing without it for a tick
+#define ghostWidth 2.0         // board units on each side of a boundary mirrored to the neighbour
+#define swarmSeparation 1.0    // drones closer than this push each other away
+#define swarmCommandTicks 5    // ticks between two random commands of a swarm drone
+#define swarmMaxForce 2
+
+#define mainDroneId 0          // the drone steered by the keyboard, the others are the swarm
+
+struct SwarmDrone {
+    int id;
+    int force[2];
+    uint64_t random;           // splitmix64 state of the drone's command stream
+    positionReal position[6];  // same layout as the shared position: initial, previous, current
+};
+
+// The window rasterizes a region's drones in place, stepping through them in positionReal units
+#define swarmStride ((int)(sizeof(struct SwarmDrone) / sizeof(positionReal)))
+_Static_assert(sizeof(struct SwarmDrone) % sizeof(positionReal) == 0, "SwarmDrone is not a whole number of positions");
+
+// Single-producer single-consumer ring: the owning shard pushes, the neighbour pops
+struct MigrationQueue {
+    atomic_uint head;
+    atomic_uint tail;
+    struct SwarmDrone slots[migrationCapacity];
+};
+
+// Seqlock-protected snapshot of the drones within ghostWidth of one edge
+struct GhostTable {
+    atomic_uint sequence;      // odd while the owner is rewriting the table
+    int count;
+    float x[ghostCapacity];
+    float y[ghostCapacity];
+};
+
+struct ShardRegion {
+    atomic_int count;                  // only written by the owning shard
+    atomic_int reserved;               // places promised to drones on their way in (shardReserve)
+    struct SwarmDrone drones[shardCapacity];
+    struct GhostTable ghosts[2];       // [0] near the left edge, [1] near the right edge
+    struct MigrationQueue outbound[2]; // [0] to the left neighbour, [1] to the right neighbour
+    atomic_ulong updates;              // drone updates done, for throughput reports
+    atomic_ulong computeNs;            // time spent on them, without the sleep to the next tick
+    atomic_uint checkpointEpoch;       // last checkpoint the shard saved its own drones for
+    atomic_uint checkpointHead[2];     // outbound[side].head at that moment: drones sent before belong to it
+};
+
+struct ShardSegment {
+    int shardCount;
+    int swarmSize;
+    atomic_int mainPlaced;             // set once shard 0 has put the keyboard drone on the board
+    atomic_int mainStarted;            // the keyboard drone stays put until the first command, as unsharded
+    atomic_uint commandSequence;       // bumped by shard 0 for every batch of keyboard commands
+    atomic_int forceDirection[2];      // latest keyboard force, applied by whichever shard owns the drone
+    atomic_ullong tick;                // simulation tick, advanced by shard 0 once the keyboard drone has started
+    atomic_uint checkpointEpoch;       // last checkpoint requested by shard 0, every checkpointInterval ticks
+    atomic_uint checkpointSlot;        // and the slot of the checkpoint file it goes to
+    struct ShardRegion regions[maxShards];
+};
+
+uint64_t shardRandom(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Strip of the board owned by a shard; the last one also owns x == boardSize
+int shardOf(double x, int shardCount) {
+    int shard = (int)(x * shardCount / boardSize);
+    return shard < 0 ? 0 : (shard >= shardCount ? shardCount - 1 : shard);
+}
+
+double shardLeftEdge(int shard, int shardCount) {
+    return (double)boardSize * shard / shardCount;
+}
+
+int migrationPush(struct MigrationQueue *queue, const struct SwarmDrone *drone) {
+    unsigned head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    if (head - tail == migrationCapacity) {
+        return 0;
+    }
+    queue->slots[head % migrationCapacity] = *drone;
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    return 1;
+}
+
+int migrationPop(struct MigrationQueue *queue, struct SwarmDrone *drone) {
+    unsigned tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    if (tail == head) {
+        return 0;
+    }
+    *drone = queue->slots[tail % migrationCapacity];
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+// Promising a place in a region to a drone on its way in: the sender reserves before it pushes the drone
+// into a migration queue and the receiver releases the place when it adopts the drone, so the drones a
+// region owns plus those promised to it never exceed shardCapacity and no drone arrives at a full region
+int shardReserve(struct ShardRegion *region) {
+    int reserved = atomic_load(&region->reserved);
+    while (atomic_load(&region->count) + reserved < shardCapacity) {
+        if (atomic_compare_exchange_weak(&region->reserved, &reserved, reserved + 1)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Sending a drone towards the neighbour on the given side (0 left, 1 right); returns 0 when the neighbour
+// has no place left or the queue is full, and the drone then stays with the sender
+int shardHandOff(struct ShardSegment *segment, int self, int side, const struct SwarmDrone *drone) {
+    struct ShardRegion *next = &segment->regions[side ? self + 1 : self - 1];
+    if (!shardReserve(next)) {
+        return 0;
+    }
+    if (!migrationPush(&segment->regions[self].outbound[side], drone)) {
+        atomic_fetch_sub(&next->reserved, 1);
+        return 0;
+    }
+    return 1;
+}
+
+void ghostBeginWrite(struct GhostTable *table) {
+    atomic_fetch_add_explicit(&table->sequence, 1, memory_order_acq_rel);
+    table->count = 0;
+}
+
+void ghostEndWrite(struct GhostTable *table) {
+    atomic_fetch_add_explicit(&table->sequence, 1, memory_order_release);
+}
+
+// A shard killed between ghostBeginWrite and ghostEndWrite leaves the sequence odd; the restarted
+// shard closes the interrupted write, with an empty table, before it writes again
+void ghostRecover(struct GhostTable *table) {
+    if (atomic_load_explicit(&table->sequence, memory_order_acquire) & 1) {
+        table->count = 0;
+        atomic_fetch_add_explicit(&table->sequence, 1, memory_order_release);
+    }
+}
+
+// Copying a neighbour's table into x/y, retrying while it is being rewritten; returns the count, or 0
+// when the table stays busy for ghostReadRetries attempts (e.g. its shard died in the middle of a write)
+int ghostRead(struct GhostTable *table, float *x, float *y) {
+    for (int attempt = 0; attempt < ghostReadRetries; attempt++) {
+        unsigned before = atomic_load_explicit(&table->sequence, memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+        int count = table->count;
+        count = count < 0 ? 0 : (count > ghostCapacity ? ghostCapacity : count);
+        memcpy(x, table->x, count * sizeof(float));
+        memcpy(y, table->y, count * sizeof(float));
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&table->sequence, memory_order_relaxed) == before) {
+            return count;
+        }
+    }
+    return 0;
+}
+
+// Giving a drone to the shard owning its strip, or to the nearest one with room if that strip is full
+// (it crosses over once there is room there); returns 0 if every strip is full. Before the shards start only.
+int shardPlace(struct ShardSegment *segment, const struct SwarmDrone *drone) {
+    int owner = shardOf(positionToDouble(drone->position[4]), segment->shardCount);
+    for (int distance = 0; distance < segment->shardCount; distance++) {
+        for (int side = -1; side <= 1; side += 2) {
+            int shard = owner + side * distance;
+            if (shard < 0 || shard >= segment->shardCount) {
+                continue;
+            }
+            struct ShardRegion *region = &segment->regions[shard];
+            if (region->count + region->reserved < shardCapacity) {
+                region->drones[region->count++] = *drone;
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Created by master before the shards start: the swarm is scattered over the board with a fixed seed
+// and every drone is placed by shardPlace. Shard 0 holds a place reserved for the keyboard drone.
+// Returns how many drones found no room at all, 0 when master checked the swarm size.
+int shardCreate(int shardCount, int swarmSize, uint64_t seed) {
+    shm_unlink(SHARD_SHM_PATH);
+    int fd = shm_open(SHARD_SHM_PATH, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        return -1;
+    }
+    if (ftruncate(fd, sizeof(struct ShardSegment)) == -1) {
+        close(fd);
+        return -1;
+    }
+    struct ShardSegment *segment = mmap(NULL, sizeof(struct ShardSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (segment == MAP_FAILED) {
+        return -1;
+    }
+
+    segment->shardCount = shardCount;
+    segment->swarmSize = swarmSize;
+    atomic_store(&segment->regions[0].reserved, 1);
+    int lost = 0;
+    for (int i = 1; i <= swarmSize; i++) {
+        struct SwarmDrone drone = {.id = i, .random = seed ^ ((uint64_t)i * 0xD1B54A32D192ED03ULL)};
+        double x = (shardRandom(&drone.random) >> 11) * (1.0 / 9007199254740992.0) * boardSize;
+        double y = (shardRandom(&drone.random) >> 11) * (1.0 / 9007199254740992.0) * boardSize;
+        for (int j = 0; j < 6; j += 2) {
+            drone.position[j] = positionFromDouble(x);
+            drone.position[j + 1] = positionFromDouble(y);
+        }
+        if (!shardPlace(segment, &drone)) {
+            lost++;
+        }
+    }
+    munmap(segment, sizeof(struct ShardSegment));
+    return lost;
+}
+
+struct ShardSegment *shardAttach() {
+    int fd = shm_open(SHARD_SHM_PATH, O_RDWR, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct ShardSegment *segment = mmap(NULL, sizeof(struct ShardSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return segment == MAP_FAILED ? NULL : segment;
+}
+
+#endif
@@ -0,0 +1,150 @@
+// sharedArena.h
+#ifndef SHARED_ARENA_H
+#define SHARED_ARENA_H
+
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Allocator for variable-sized structures shared between processes. Every process maps the arena at
+// a different address, so links between blocks are offsets from the start of the arena, never pointers.
+// Blocks come in power-of-two size classes; freed blocks go to the free list of their class and are
+// reused before new space is carved from the end. Only one process (the writer) allocates and frees,
+// so the metadata needs no lock; readers only follow offsets and must validate what they read with
+// the version of the structure they are reading (see world.h).
+
+#define ARENA_MAGIC 0x41524e41
+#define arenaMinShift 4     // smallest block: 16 bytes including the header
+#define arenaClasses 12     // up to 32 KB
+
+typedef uint32_t arenaOffset; // 0 is the null offset, the header lives there
+
+struct ArenaHeader {
+    uint32_t magic;
+    uint32_t size;
+    atomic_uint top;                     // first byte never handed out
+    atomic_uint freeLists[arenaClasses]; // head block of each size class
+    atomic_uint root;                    // structure the arena was created for
+    atomic_uint liveBlocks;
+};
+
+// Header in front of every block; next is only meaningful while the block is on a free list
+struct ArenaBlock {
+    uint32_t sizeClass;
+    arenaOffset next;
+};
+
+// Offset -> pointer in this process, NULL for the null offset or anything outside the arena
+void *arenaPointer(struct ArenaHeader *arena, arenaOffset offset, size_t bytes) {
+    if (offset == 0 || offset < sizeof(struct ArenaHeader) || (uint64_t)offset + bytes > arena->size) {
+        return NULL;
+    }
+    return (char *)arena + offset;
+}
+
+arenaOffset arenaOffsetOf(struct ArenaHeader *arena, const void *pointer) {
+    return pointer == NULL ? 0 : (arenaOffset)((const char *)pointer - (const char *)arena);
+}
+
+int arenaClassFor(size_t bytes) {
+    size_t block = bytes + sizeof(struct ArenaBlock);
+    for (int sizeClass = 0; sizeClass < arenaClasses; sizeClass++) {
+        if (block <= ((size_t)1 << (sizeClass + arenaMinShift))) {
+            return sizeClass;
+        }
+    }
+    return -1;
+}
+
+// Returning the offset of a payload of at least bytes, 0 when the arena is full. Writer only.
+arenaOffset arenaAlloc(struct ArenaHeader *arena, size_t bytes) {
+    int sizeClass = arenaClassFor(bytes);
+    if (sizeClass < 0) {
+        return 0;
+    }
+    uint32_t blockSize = 1u << (sizeClass + arenaMinShift);
+    struct ArenaBlock *block;
+
+    arenaOffset head = atomic_load_explicit(&arena->freeLists[sizeClass], memory_order_relaxed);
+    if (head != 0) {
+        block = (struct ArenaBlock *)((char *)arena + head);
+        atomic_store_explicit(&arena->freeLists[sizeClass], block->next, memory_order_relaxed);
+    } else {
+        uint32_t top = atomic_load_explicit(&arena->top, memory_order_relaxed);
+        if ((uint64_t)top + blockSize > arena->size) {
+            return 0;
+        }
+        block = (struct ArenaBlock *)((char *)arena + top);
+        atomic_store_explicit(&arena->top, top + blockSize, memory_order_relaxed);
+    }
+    block->sizeClass = sizeClass;
+    block->next = 0;
+    atomic_fetch_add_explicit(&arena->liveBlocks, 1, memory_order_relaxed);
+    return arenaOffsetOf(arena, block + 1);
+}
+
+// Writer only; readers still walking an old version may see the block reused and must retry
+void arenaFree(struct ArenaHeader *arena, arenaOffset offset) {
+    if (offset < sizeof(struct ArenaBlock)) {
+        return;
+    }
+    struct ArenaBlock *block = arenaPointer(arena, offset - sizeof(struct ArenaBlock), sizeof(struct ArenaBlock));
+    if (block == NULL || block->sizeClass >= arenaClasses) {
+        return;
+    }
+    block->next = atomic_load_explicit(&arena->freeLists[block->sizeClass], memory_order_relaxed);
+    atomic_store_explicit(&arena->freeLists[block->sizeClass], arenaOffsetOf(arena, block), memory_order_relaxed);
+    atomic_fetch_sub_explicit(&arena->liveBlocks, 1, memory_order_relaxed);
+}
+
+// Creating an empty arena of size bytes; NULL on failure
+struct ArenaHeader *arenaCreate(const char *path, uint32_t size) {
+    int fd = shm_open(path, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (ftruncate(fd, size) == -1) {
+        close(fd);
+        return NULL;
+    }
+    struct ArenaHeader *arena = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (arena == MAP_FAILED) {
+        return NULL;
+    }
+    memset(arena, 0, sizeof(*arena));
+    arena->size = size;
+    atomic_store(&arena->top, sizeof(struct ArenaHeader));
+    atomic_thread_fence(memory_order_release);
+    arena->magic = ARENA_MAGIC;
+    return arena;
+}
+
+// Mapping an existing arena with the size recorded in its header; NULL if there is none yet
+struct ArenaHeader *arenaAttach(const char *path, int writable) {
+    int fd = shm_open(path, writable ? O_RDWR : O_RDONLY, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == -1 || info.st_size < (off_t)sizeof(struct ArenaHeader)) {
+        close(fd);
+        return NULL;
+    }
+    struct ArenaHeader *arena = mmap(NULL, info.st_size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (arena == MAP_FAILED) {
+        return NULL;
+    }
+    if (arena->magic != ARENA_MAGIC || arena->size > info.st_size) {
+        munmap(arena, info.st_size);
+        return NULL;
+    }
+    return arena;
+}
+
+#endif
@@ -0,0 +1,104 @@
+// sharedState.h
+#ifndef SHARED_STATE_H
+#define SHARED_STATE_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "droneModel.h"
+
+// Layout of the SHM_PATH segment. The position stays first, so copying sizeof(position) bytes
+// from the start of the segment (under the semaphore) is unchanged; the generation counter after
+// it is bumped on every publish and lets consumers sleep in the kernel until the state changes.
+struct SharedState {
+    positionReal position[6];
+    atomic_uint generation;
+    atomic_uint waiters;    // consumers inside stateWait, the publisher skips the wake syscall when 0
+    atomic_int forceDirection[2];   // last force applied by droneDynamics, resumed by restarted components
+    atomic_ulong commandsSent;      // keyboard -> drone commands written by keyboardManager
+    atomic_ulong commandsReceived;  // and read by droneDynamics; the load generator reports the difference
+    atomic_ulong commandsCoalesced; // read ones droneDynamics never applied because a later one was queued
+};
+
+void statePublishForce(struct SharedState *state, const int *force) {
+    atomic_store_explicit(&state->forceDirection[0], force[0], memory_order_relaxed);
+    atomic_store_explicit(&state->forceDirection[1], force[1], memory_order_relaxed);
+}
+
+void stateForce(struct SharedState *state, int *force) {
+    force[0] = atomic_load_explicit(&state->forceDirection[0], memory_order_relaxed);
+    force[1] = atomic_load_explicit(&state->forceDirection[1], memory_order_relaxed);
+}
+
+// Mapping the segment for a component that does not get it from its launch; NULL while server has not created it
+struct SharedState *stateAttach(const char *path) {
+    int fd = shm_open(path, O_RDWR, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct SharedState *state = mmap(NULL, sizeof(struct SharedState), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return state == MAP_FAILED ? NULL : state;
+}
+
+// The segment is shared between processes, so the futex calls must not use FUTEX_PRIVATE_FLAG
+long stateFutex(atomic_uint *word, int op, unsigned value, const struct timespec *timeout) {
+    return syscall(SYS_futex, word, op, value, timeout, NULL, FUTEX_BITSET_MATCH_ANY);
+}
+
+// Called by the writer after copying a new position in (and releasing the semaphore)
+void statePublish(struct SharedState *state) {
+    atomic_fetch_add_explicit(&state->generation, 1, memory_order_seq_cst);
+    if (atomic_load_explicit(&state->waiters, memory_order_seq_cst) > 0) {
+        stateFutex(&state->generation, FUTEX_WAKE, INT_MAX, NULL);
+    }
+}
+
+unsigned stateGeneration(struct SharedState *state) {
+    return atomic_load_explicit(&state->generation, memory_order_acquire);
+}
+
+// Blocking until the generation differs from seen or timeoutUs elapses; returns the current generation,
+// equal to seen on timeout. Signals (the watchdog's pings) do not cut the wait short.
+unsigned stateWait(struct SharedState *state, unsigned seen, long timeoutUs) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeoutUs / 1000000;
+    deadline.tv_nsec += (timeoutUs % 1000000) * 1000;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_nsec -= 1000000000L;
+        deadline.tv_sec++;
+    }
+
+    unsigned current;
+    while ((current = stateGeneration(state)) == seen) {
+        atomic_fetch_add_explicit(&state->waiters, 1, memory_order_seq_cst);
+        // FUTEX_WAIT_BITSET takes an absolute CLOCK_MONOTONIC deadline, so EINTR retries keep the original timeout
+        long result = stateFutex(&state->generation, FUTEX_WAIT_BITSET, seen, &deadline);
+        atomic_fetch_sub_explicit(&state->waiters, 1, memory_order_seq_cst);
+        if (result == -1 && errno == ETIMEDOUT) {
+            return stateGeneration(state);
+        }
+    }
+    return current;
+}
+
+// Per-consumer rate cap: sleeping until intervalUs after the previous call, whatever signals arrive
+void stateRateLimit(long long *lastNs, long intervalUs) {
+    long long due = *lastNs + intervalUs * 1000LL;
+    struct timespec deadline = {due / 1000000000LL, due % 1000000000LL};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    *lastNs = (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+#endif
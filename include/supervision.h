@@ -0,0 +1,66 @@
+// supervision.h
+#ifndef SUPERVISION_H
+#define SUPERVISION_H
+
+#include <stdio.h>
+#include <time.h>
+
+// Options that master passes to every component as argv[2]
+struct LaunchOptions {
+    long long restartedAt; // CLOCK_MONOTONIC time (ns) at which master detected the failure, 0 on a fresh start
+    int supervise;         // 1 when master restarts failed components instead of tearing everything down
+    int masterPID;         // lets the watchdog ask master for a full shutdown
+    int restore;           // 1 to resume from the last checkpoint instead of the default start position
+    int realtime;          // 1 when the low-jitter real-time profile is enabled
+    int shard;             // strip simulated by this droneDynamics instance
+    int shards;            // number of droneDynamics instances, 1 when the board is not sharded
+    int virtualClock;      // 1 when time is simulated by master's clock (virtualClock.h) instead of the wall clock
+};
+
+// What every droneDynamics instance (one per shard) sends on the watchdog's drone pipe, so that each
+// shard is pinged and, when it hangs, killed for a restart on its own
+struct DronePID {
+    int shard;
+    int pid;
+};
+
+// Monotonic time in nanoseconds, comparable between processes
+long long monotonicNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void formatLaunchOptions(char *buffer, size_t size, struct LaunchOptions *options) {
+    snprintf(buffer, size, "%lld %d %d %d %d %d %d %d", options->restartedAt, options->supervise, options->masterPID,
+             options->restore, options->realtime, options->shard, options->shards, options->virtualClock);
+}
+
+// Missing or partial options keep their defaults, so components can still be started by hand
+void parseLaunchOptions(int argc, char *argv[], struct LaunchOptions *options) {
+    options->restartedAt = 0;
+    options->supervise = 0;
+    options->masterPID = 0;
+    options->restore = 0;
+    options->realtime = 0;
+    options->shard = 0;
+    options->shards = 1;
+    options->virtualClock = 0;
+    if (argc > 2) {
+        sscanf(argv[2], "%lld %d %d %d %d %d %d %d", &options->restartedAt, &options->supervise, &options->masterPID,
+               &options->restore, &options->realtime, &options->shard, &options->shards, &options->virtualClock);
+    }
+}
+
+// Logging how long a restarted component took to get back to a working state
+void logRecovery(FILE *logFile, const char *name, struct LaunchOptions *options) {
+    if (options->restartedAt == 0) {
+        return;
+    }
+    double recoveryMs = (monotonicNs() - options->restartedAt) / 1e6;
+    fprintf(logFile, "%s restarted, recovered in %.2f ms%s\n", name, recoveryMs,
+            recoveryMs > recoveryBudgetMs ? " (over budget)" : "");
+    fflush(logFile);
+}
+
+#endif
@@ -0,0 +1,152 @@
+// virtualClock.h
+#ifndef VIRTUAL_CLOCK_H
+#define VIRTUAL_CLOCK_H
+
+#include <limits.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "sharedState.h"
+
+// Virtual-clock mode (./bin/master -l -v): instead of sleeping on the wall clock, the components that
+// drive the simulation (participants) tell a shared clock when they next need to run and block. Once
+// every participant is blocked, master's clock driver jumps simulated time to the earliest wake-up and
+// lets that one participant run, so exactly one of them runs at a time and a run is as fast as its
+// slowest step allows. Participants due at the same instant run in slot order, which reproduces the
+// order a real-time run sees: keys first, then the command they turn into, then the drone tick.
+
+#define CLOCK_SHM_PATH "/clock_shm"
+#define clockNever LLONG_MAX // wake-up of a participant that only runs when notified
+
+enum {
+    clockKeySource,     // load generator
+    clockCommandSource, // keyboardManager or autopilot
+    clockDrone,         // droneDynamics
+    clockParticipants
+};
+
+struct ClockParticipant {
+    atomic_int attached;
+    atomic_int waiting;     // set while blocked in clockSleepUntil, cleared by the driver when it grants a turn
+    atomic_llong wakeAt;    // simulated ns
+    atomic_uint turn;       // futex word the participant blocks on, bumped for every turn granted
+};
+
+struct VirtualClock {
+    atomic_llong now;       // simulated ns since the start of the run
+    atomic_uint idle;       // futex word of the driver, bumped whenever a participant blocks or leaves
+    atomic_ulong turns;
+    struct ClockParticipant participants[clockParticipants];
+};
+
+// Created by master before the components start; NULL on failure
+struct VirtualClock *clockCreate() {
+    shm_unlink(CLOCK_SHM_PATH);
+    int fd = shm_open(CLOCK_SHM_PATH, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (ftruncate(fd, sizeof(struct VirtualClock)) == -1) {
+        close(fd);
+        return NULL;
+    }
+    struct VirtualClock *clock = mmap(NULL, sizeof(struct VirtualClock), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return clock == MAP_FAILED ? NULL : clock;
+}
+
+struct VirtualClock *clockAttach() {
+    int fd = shm_open(CLOCK_SHM_PATH, O_RDWR, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct VirtualClock *clock = mmap(NULL, sizeof(struct VirtualClock), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return clock == MAP_FAILED ? NULL : clock;
+}
+
+long long clockNow(struct VirtualClock *clock) {
+    return atomic_load(&clock->now);
+}
+
+void clockIdle(struct VirtualClock *clock) {
+    atomic_fetch_add(&clock->idle, 1);
+    stateFutex(&clock->idle, FUTEX_WAKE, 1, NULL);
+}
+
+// Participant: handing the clock back until simulated time reaches wakeAt (or a notification comes),
+// returns the simulated time of the turn. The first call also registers the participant.
+long long clockSleepUntil(struct VirtualClock *clock, int slot, long long wakeAt) {
+    struct ClockParticipant *self = &clock->participants[slot];
+    unsigned turn = atomic_load(&self->turn);
+    atomic_store(&self->wakeAt, wakeAt);
+    atomic_store(&self->waiting, 1);
+    atomic_store(&self->attached, 1);
+    clockIdle(clock);
+    while (atomic_load(&self->turn) == turn) {
+        stateFutex(&self->turn, FUTEX_WAIT, turn, NULL); // EINTR from the watchdog's pings just loops
+    }
+    return clockNow(clock);
+}
+
+// Participant: registering and waiting for the first turn, at the current simulated time. The result is
+// where the participant's own schedule starts: 0 on a fresh run, later for a restarted component.
+long long clockJoin(struct VirtualClock *clock, int slot) {
+    return clockSleepUntil(clock, slot, clockNow(clock));
+}
+
+// Participant, during its turn: making another participant due now, e.g. after writing to its pipe
+void clockNotify(struct VirtualClock *clock, int slot) {
+    struct ClockParticipant *other = &clock->participants[slot];
+    long long now = clockNow(clock);
+    if (atomic_load(&other->wakeAt) > now) {
+        atomic_store(&other->wakeAt, now);
+    }
+}
+
+// Participant leaving the run; the clock stops until it is back (a restarted component re-registers)
+void clockDetach(struct VirtualClock *clock, int slot) {
+    atomic_store(&clock->participants[slot].attached, 0);
+    clockIdle(clock);
+}
+
+// Driver, run by master: waiting until every participant is registered and blocked, then granting
+// one turn at a time to the earliest wake-up; ties go to the lowest slot. Never returns.
+void *clockDrive(void *argument) {
+    struct VirtualClock *clock = argument;
+    while (1) {
+        unsigned idle = atomic_load(&clock->idle);
+        int ready = 1, next = -1;
+        long long nextAt = clockNever;
+        for (int slot = 0; slot < clockParticipants; slot++) {
+            struct ClockParticipant *participant = &clock->participants[slot];
+            if (!atomic_load(&participant->attached) || !atomic_load(&participant->waiting)) {
+                ready = 0;
+                break;
+            }
+            long long wakeAt = atomic_load(&participant->wakeAt);
+            if (wakeAt < nextAt) {
+                nextAt = wakeAt;
+                next = slot;
+            }
+        }
+        if (!ready || next < 0) {
+            stateFutex(&clock->idle, FUTEX_WAIT, idle, NULL);
+            continue;
+        }
+
+        struct ClockParticipant *participant = &clock->participants[next];
+        if (nextAt > clockNow(clock)) {
+            atomic_store(&clock->now, nextAt);
+        }
+        atomic_store(&participant->waiting, 0);
+        atomic_fetch_add(&participant->turn, 1);
+        atomic_fetch_add(&clock->turns, 1);
+        stateFutex(&participant->turn, FUTEX_WAKE, 1, NULL);
+    }
+    return NULL;
+}
+
+#endif
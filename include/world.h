@@ -0,0 +1,209 @@
+// world.h
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include "sharedArena.h"
+
+// Obstacles and targets on the board, kept by server in a shared arena as a linked list of items.
+// Server is the only writer; window, droneDynamics and anyone else read the list in place.
+// Every change happens between two increments of version (odd while changing), so a reader that
+// sees the same even version before and after its walk has a consistent copy.
+
+#define WORLD_SHM_PATH "/world_shm"
+#define worldArenaSize (1 << 20)
+#define worldMaxItems 1024 // items a reader copies at most
+#define worldSnapshotRetries 100
+
+enum {
+    worldObstacle,
+    worldTarget
+};
+
+struct WorldItem {
+    arenaOffset next;
+    int kind;
+    float x0, y0, x1, y1;  // obstacles are rectangles, targets have x0 == x1 and y0 == y1
+};
+
+struct WorldList {
+    atomic_uint version;
+    arenaOffset head;
+    uint32_t count;
+};
+
+struct WorldList *worldList(struct ArenaHeader *arena) {
+    return arenaPointer(arena, atomic_load_explicit(&arena->root, memory_order_acquire), sizeof(struct WorldList));
+}
+
+// Writer: allocating the empty list and making it the root of the arena
+struct WorldList *worldCreate(struct ArenaHeader *arena) {
+    arenaOffset offset = arenaAlloc(arena, sizeof(struct WorldList));
+    struct WorldList *list = arenaPointer(arena, offset, sizeof(struct WorldList));
+    if (list == NULL) {
+        return NULL;
+    }
+    atomic_init(&list->version, 0);
+    list->head = 0;
+    list->count = 0;
+    atomic_store_explicit(&arena->root, offset, memory_order_release);
+    return list;
+}
+
+void worldBeginUpdate(struct WorldList *list) {
+    atomic_fetch_add_explicit(&list->version, 1, memory_order_acq_rel);
+}
+
+void worldEndUpdate(struct WorldList *list) {
+    atomic_fetch_add_explicit(&list->version, 1, memory_order_release);
+}
+
+// Writer attaching to the list of a server that died in the middle of an update (odd version): the
+// half-changed list is dropped, its items stay allocated in the arena, and the version made even again
+void worldRecover(struct WorldList *list) {
+    if (atomic_load_explicit(&list->version, memory_order_acquire) & 1) {
+        list->head = 0;
+        list->count = 0;
+        worldEndUpdate(list);
+    }
+}
+
+// Writer, between worldBeginUpdate and worldEndUpdate; returns 0 when the arena is full
+int worldAdd(struct ArenaHeader *arena, struct WorldList *list, int kind, float x0, float y0, float x1, float y1) {
+    arenaOffset offset = arenaAlloc(arena, sizeof(struct WorldItem));
+    struct WorldItem *item = arenaPointer(arena, offset, sizeof(struct WorldItem));
+    if (item == NULL) {
+        return 0;
+    }
+    item->kind = kind;
+    item->x0 = x0 < x1 ? x0 : x1;
+    item->x1 = x0 < x1 ? x1 : x0;
+    item->y0 = y0 < y1 ? y0 : y1;
+    item->y1 = y0 < y1 ? y1 : y0;
+    item->next = list->head;
+    list->head = offset;
+    list->count++;
+    return 1;
+}
+
+// Writer, between worldBeginUpdate and worldEndUpdate: every item goes back to the arena
+void worldClear(struct ArenaHeader *arena, struct WorldList *list) {
+    arenaOffset offset = list->head;
+    while (offset != 0) {
+        struct WorldItem *item = arenaPointer(arena, offset, sizeof(struct WorldItem));
+        if (item == NULL) {
+            break;
+        }
+        arenaOffset next = item->next;
+        arenaFree(arena, offset);
+        offset = next;
+    }
+    list->head = 0;
+    list->count = 0;
+}
+
+// Writer: replacing the whole list with count items in one update; returns the number of items in the list
+int worldReplace(struct ArenaHeader *arena, struct WorldList *list, const struct WorldItem *items, int count) {
+    worldBeginUpdate(list);
+    worldClear(arena, list);
+    for (int i = count - 1; i >= 0; i--) { // worldAdd prepends, so the list keeps the given order
+        worldAdd(arena, list, items[i].kind, items[i].x0, items[i].y0, items[i].x1, items[i].y1);
+    }
+    worldEndUpdate(list);
+    return list->count;
+}
+
+// Writer: replacing the list with the obstacles and targets of a mission file (same format as the autopilot's);
+// returns the number of items, -1 if the file cannot be read. The file is parsed before the update starts,
+// so readers only ever wait for the list to be rebuilt, not for the disk.
+int worldLoad(struct ArenaHeader *arena, struct WorldList *list, const char *path, FILE *logFile) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(logFile, "Cannot open world %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    // Readers copy at most worldMaxItems items, so a larger world is cut there rather than partly ignored by them
+    static struct WorldItem parsed[worldMaxItems];
+    int count = 0, ignored = 0;
+    char line[200];
+    float a, b, c, d;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        struct WorldItem item = {0};
+        if (sscanf(line, "obstacle %f %f %f %f", &a, &b, &c, &d) == 4) {
+            item = (struct WorldItem){0, worldObstacle, a, b, c, d};
+        } else if (sscanf(line, "target %f %f", &a, &b) == 2) {
+            item = (struct WorldItem){0, worldTarget, a, b, a, b};
+        } else {
+            continue;
+        }
+        if (count < worldMaxItems) {
+            parsed[count++] = item;
+        } else {
+            ignored++;
+        }
+    }
+    fclose(file);
+    if (ignored > 0) {
+        fprintf(logFile, "World %s has %d items, only the first %d are loaded\n", path, count + ignored, worldMaxItems);
+    }
+
+    return worldReplace(arena, list, parsed, count);
+}
+
+// Reader: copying up to max items, retrying while the writer is changing the list and giving the CPU
+// to it between two attempts; returns the number of items and stores the version they belong to.
+// After worldSnapshotRetries busy attempts it returns -1 with items partly overwritten and version as it
+// was, so the caller copies into a spare buffer, keeps using its last good copy and tries again later.
+int worldSnapshot(struct ArenaHeader *arena, struct WorldItem *items, int max, unsigned *version) {
+    struct WorldList *list = worldList(arena);
+    if (list == NULL) {
+        *version = 0;
+        return 0;
+    }
+    for (int attempt = 0; attempt < worldSnapshotRetries; attempt++) {
+        if (attempt > 0) {
+            sched_yield();
+        }
+        unsigned before = atomic_load_explicit(&list->version, memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+        int count = 0;
+        arenaOffset offset = list->head;
+        while (offset != 0 && count < max) {
+            struct WorldItem *item = arenaPointer(arena, offset, sizeof(struct WorldItem));
+            if (item == NULL) {
+                break; // torn read of a link, the version check below catches it
+            }
+            items[count++] = *item;
+            offset = items[count - 1].next;
+        }
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&list->version, memory_order_relaxed) == before) {
+            *version = before;
+            return count;
+        }
+    }
+    return -1;
+}
+
+unsigned worldVersion(struct ArenaHeader *arena) {
+    struct WorldList *list = worldList(arena);
+    return list == NULL ? 0 : atomic_load_explicit(&list->version, memory_order_acquire);
+}
+
+// Whether (x, y) lies inside one of the obstacles of a snapshot
+int worldBlocked(const struct WorldItem *items, int count, double x, double y) {
+    for (int i = 0; i < count; i++) {
+        if (items[i].kind == worldObstacle && x >= items[i].x0 && x <= items[i].x1 && y >= items[i].y0 && y <= items[i].y1) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,342 @@
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <time.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../include/constant.h"
+#include "../include/supervision.h"
+#include "../include/realtime.h"
+#include "../include/droneModel.h"
+#include "../include/dstarLite.h"
+#include "../include/virtualClock.h"
+
+// Autopilot: drop-in replacement for keyboardManager (./bin/master -a mission.txt). It reads the drone
+// position from shared memory, plans on a grid of plannerResolution cells per board unit and sends the
+// same forceDirection commands the keyboard would.
+//
+// Every waypoint has its own D* Lite planner searching from the waypoint towards the drone. All of them
+// follow the drone and the obstacles incrementally, so reaching a waypoint switches to a planner that is
+// already up to date; only a waypoint moved in the mission file starts its planner's search again.
+//
+// Mission file, reloaded whenever it is modified:
+//   target x y           waypoints, visited in order
+//   obstacle x0 y0 x1 y1 blocked rectangle in board units
+
+#define maxTargets 64
+
+struct Mission {
+    int targetCount;
+    double targets[maxTargets][2];
+    unsigned char *blocked; // one byte per planner cell
+};
+
+int gridSize() {
+    return boardSize * plannerResolution + 1;
+}
+
+int cellOf(double x) {
+    int cell = (int)lround(x * plannerResolution);
+    return cell < 0 ? 0 : (cell >= gridSize() ? gridSize() - 1 : cell);
+}
+
+double centerOf(int cell) {
+    return (double)cell / plannerResolution;
+}
+
+// Parsing the mission file; returns -1 if it cannot be opened, the previous mission is kept then
+int loadMission(const char *path, struct Mission *mission, FILE *logFile) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(logFile, "Cannot open mission %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    int size = gridSize();
+    mission->targetCount = 0;
+    memset(mission->blocked, 0, (size_t)size * size);
+
+    char line[maxMsgLength];
+    int lineNumber = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        lineNumber++;
+        double a, b, c, d;
+        if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0') {
+            continue;
+        }
+        if (sscanf(line, "target %lf %lf", &a, &b) == 2) {
+            if (mission->targetCount < maxTargets) {
+                mission->targets[mission->targetCount][0] = fmax(0, fmin(a, boardSize));
+                mission->targets[mission->targetCount][1] = fmax(0, fmin(b, boardSize));
+                mission->targetCount++;
+            }
+        } else if (sscanf(line, "obstacle %lf %lf %lf %lf", &a, &b, &c, &d) == 4) {
+            for (int y = cellOf(fmin(b, d)); y <= cellOf(fmax(b, d)); y++) {
+                for (int x = cellOf(fmin(a, c)); x <= cellOf(fmax(a, c)); x++) {
+                    mission->blocked[y * size + x] = 1;
+                }
+            }
+        } else {
+            fprintf(logFile, "Mission %s:%d not understood: %s", path, lineNumber, line);
+        }
+    }
+    fclose(file);
+    return 0;
+}
+
+// Force that brings the velocity to targetVelocity in one tick (inverse of computePosition), within the keyboard's range
+int forceFor(double targetVelocity, double velocity) {
+    double force = (targetVelocity + velocity * M / (M + K * T)) / T;
+    long rounded = lround(force);
+    return rounded > autopilotMaxForce ? autopilotMaxForce : (rounded < -autopilotMaxForce ? -autopilotMaxForce : (int)rounded);
+}
+
+double clampVelocity(double velocity) {
+    return fmax(-autopilotCruise, fmin(velocity, autopilotCruise));
+}
+
+int main(int argc, char *argv[]) {
+    // Pipes, same layout as keyboardManager
+    int pipeKeyboardDrone[2], pipeWindowKeyboard[2], pipeWatchdogKeyboard[2];
+    pid_t autopilotPID = getpid();
+    sscanf(argv[1], "%d %d|%d %d|%d %d", &pipeWindowKeyboard[0], &pipeWindowKeyboard[1],
+           &pipeKeyboardDrone[0], &pipeKeyboardDrone[1],
+           &pipeWatchdogKeyboard[0], &pipeWatchdogKeyboard[1]);
+    close(pipeWindowKeyboard[1]);
+    close(pipeKeyboardDrone[0]);
+    close(pipeWatchdogKeyboard[0]);
+    write(pipeWatchdogKeyboard[1], &autopilotPID, sizeof(autopilotPID));
+    close(pipeWatchdogKeyboard[1]);
+
+    struct LaunchOptions launchOptions;
+    parseLaunchOptions(argc, argv, &launchOptions);
+    const char *missionPath = argc > 3 ? argv[3] : "mission.txt";
+
+    // Keys are only checked for 'q', the window must never block on a full pipe
+    int flags = fcntl(pipeWindowKeyboard[0], F_GETFL);
+    fcntl(pipeWindowKeyboard[0], F_SETFL, flags | O_NONBLOCK);
+
+    // Signal handeling for watchdog
+    struct sigaction signal_action;
+    signal_action.sa_sigaction = handleSignal;
+    signal_action.sa_flags = SA_SIGINFO;
+    sigaction(SIGINT, &signal_action, NULL);
+    sigaction(SIGUSR1, &signal_action, NULL);
+
+    // Open the log file
+    FILE *logFile = fopen("log/autopilotLog.txt", launchOptions.restartedAt ? "a" : "w");
+    if (logFile == NULL) {
+        perror("Error opening log file\n");
+        exit(EXIT_FAILURE);
+    }
+    logRecovery(logFile, "Autopilot", &launchOptions);
+
+    // Shared memory setup
+    positionReal position[6];
+    int sharedSegSize = sizeof(position);
+    sem_t *semaphoreID = sem_open(SEM_PATH, 0);
+    if (semaphoreID == SEM_FAILED) {
+        perror("sem_open");
+        exit(EXIT_FAILURE);
+    }
+    int shmFD = shm_open(SHM_PATH, O_RDWR, S_IRWXU | S_IRWXG);
+    if (shmFD < 0) {
+        perror("shm_open");
+        exit(EXIT_FAILURE);
+    }
+    void *shmPointer = mmap(NULL, sharedSegSize, PROT_READ, MAP_SHARED, shmFD, 0);
+    if (shmPointer == MAP_FAILED) {
+        perror("mmap");
+        exit(EXIT_FAILURE);
+    }
+
+    // Planners, allocated as waypoints appear, and mission
+    int size = gridSize();
+    static struct DStarLite planners[maxTargets];
+    static int reachable[maxTargets];
+    int plannerCount = 0;
+    struct Mission mission = {0};
+    mission.blocked = calloc((size_t)size * size, 1);
+    if (mission.blocked == NULL) {
+        perror("planner allocation");
+        exit(EXIT_FAILURE);
+    }
+    struct stat missionLoaded;
+    memset(&missionLoaded, 0, sizeof(missionLoaded));
+    int targetIndex = 0;
+
+    if (launchOptions.realtime) {
+        setvbuf(logFile, NULL, _IOFBF, 1 << 16);
+        applyRealtimeMemory(logFile, shmPointer, sharedSegSize);
+    }
+
+    // With the virtual clock the autopilot steps on the drone's tick instants, just before the drone
+    struct VirtualClock *virtualClock = NULL;
+    long long virtualStart = 0;
+    if (launchOptions.virtualClock) {
+        virtualClock = clockAttach();
+        if (virtualClock == NULL) {
+            perror("virtual clock");
+            exit(EXIT_FAILURE);
+        }
+        virtualStart = clockJoin(virtualClock, clockCommandSource);
+    }
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    unsigned long ticks = 0;
+    int forceDirection[2] = {0, 0};
+
+    while (1) {
+        // Draining the window's keys, only 'q' matters
+        int keys[64];
+        ssize_t keyRead = read(pipeWindowKeyboard[0], keys, sizeof(keys));
+        for (int i = 0; i < keyRead / (ssize_t)sizeof(int); i++) {
+            if ((char)keys[i] == 'q') {
+                if (virtualClock != NULL) {
+                    clockDetach(virtualClock, clockCommandSource);
+                }
+                close(pipeWindowKeyboard[0]);
+                close(pipeKeyboardDrone[1]);
+                fclose(logFile);
+                exit(EXIT_SUCCESS);
+            }
+        }
+
+        sem_wait(semaphoreID);
+        memcpy(position, shmPointer, sharedSegSize);
+        sem_post(semaphoreID);
+        double x = positionToDouble(position[4]), y = positionToDouble(position[5]);
+        double velocity[2] = {x - positionToDouble(position[2]), y - positionToDouble(position[3])};
+        int start = cellOf(y) * size + cellOf(x);
+
+        // Reloading the mission: changed cells are repaired incrementally in every planner, a moved waypoint
+        // restarts its own planner's search. Whole seconds would miss a second edit within the same second,
+        // hence nanoseconds, size and inode
+        struct stat missionStat;
+        if (stat(missionPath, &missionStat) == 0 &&
+            (missionStat.st_mtim.tv_sec != missionLoaded.st_mtim.tv_sec || missionStat.st_mtim.tv_nsec != missionLoaded.st_mtim.tv_nsec ||
+             missionStat.st_size != missionLoaded.st_size || missionStat.st_ino != missionLoaded.st_ino) &&
+            loadMission(missionPath, &mission, logFile) == 0) {
+            missionLoaded = missionStat;
+            for (; plannerCount < mission.targetCount; plannerCount++) {
+                if (dstarInit(&planners[plannerCount], size, size) == -1) {
+                    perror("planner allocation");
+                    exit(EXIT_FAILURE);
+                }
+                memcpy(planners[plannerCount].blocked, plannerCount > 0 ? planners[0].blocked : mission.blocked, (size_t)size * size);
+            }
+            int changed = 0, restarted = 0;
+            for (int cell = 0; cell < size * size; cell++) {
+                if (planners[0].blocked[cell] != mission.blocked[cell]) {
+                    for (int i = 0; i < plannerCount; i++) {
+                        dstarSetBlocked(&planners[i], cell, mission.blocked[cell]);
+                    }
+                    changed++;
+                }
+            }
+            for (int i = 0; i < mission.targetCount; i++) {
+                int goal = cellOf(mission.targets[i][1]) * size + cellOf(mission.targets[i][0]);
+                if (planners[i].goal != goal) {
+                    dstarSetGoal(&planners[i], start, goal);
+                    restarted++;
+                }
+            }
+            if (targetIndex >= mission.targetCount) {
+                targetIndex = 0;
+            }
+            fprintf(logFile, "Mission loaded: %d targets (%d new searches), %d cells changed\n",
+                    mission.targetCount, restarted, changed);
+        }
+
+        if (mission.targetCount > 0) {
+            double *target = mission.targets[targetIndex];
+            double distance = hypot(target[0] - x, target[1] - y);
+
+            // Moving on to the next waypoint once this one is reached, the last one is held
+            if (distance < autopilotTolerance && targetIndex < mission.targetCount - 1) {
+                fprintf(logFile, "Reached target %d (%.2f, %.2f)\n", targetIndex, target[0], target[1]);
+                target = mission.targets[++targetIndex];
+                distance = hypot(target[0] - x, target[1] - y);
+            }
+
+            // Every waypoint's planner follows the drone, the current one steers it
+            long long planStart = monotonicNs();
+            unsigned long expanded = 0;
+            for (int i = 0; i < mission.targetCount; i++) {
+                dstarMoveStart(&planners[i], start);
+                reachable[i] = dstarComputePath(&planners[i]);
+                expanded += planners[i].expanded;
+            }
+            double planUs = (monotonicNs() - planStart) / 1e3;
+            struct DStarLite *planner = &planners[targetIndex];
+
+            // Heading for the next cell of the path, or straight for the target in its own cell
+            double aim[2] = {target[0], target[1]};
+            if (reachable[targetIndex] && start != planner->goal) {
+                int next = dstarNextStep(planner);
+                aim[0] = centerOf(next % size);
+                aim[1] = centerOf(next / size);
+                if (distance > 1.0 / plannerResolution) {
+                    double scale = autopilotCruise / hypot(aim[0] - x, aim[1] - y);
+                    aim[0] = x + (aim[0] - x) * scale;
+                    aim[1] = y + (aim[1] - y) * scale;
+                }
+            }
+            if (reachable[targetIndex]) {
+                forceDirection[0] = forceFor(clampVelocity(aim[0] - x), velocity[0]);
+                forceDirection[1] = forceFor(clampVelocity(aim[1] - y), velocity[1]);
+            } else {
+                forceDirection[0] = forceFor(0, velocity[0]);
+                forceDirection[1] = forceFor(0, velocity[1]);
+            }
+
+            fprintf(logFile, "Position (%.2f, %.2f), target %d (%.2f, %.2f)%s, %d planners expanded %lu cells in %.1f us, "
+                    "Force Direction: [%d, %d]\n", x, y, targetIndex, target[0], target[1],
+                    reachable[targetIndex] ? "" : " unreachable", mission.targetCount, expanded, planUs,
+                    forceDirection[0], forceDirection[1]);
+        }
+
+        // Sending the force direction to drone.c, retrying on EINTR like keyboardManager
+        int updateForceDirection;
+        do {
+            updateForceDirection = write(pipeKeyboardDrone[1], forceDirection, sizeof(forceDirection));
+        } while (updateForceDirection == -1 && errno == EINTR);
+        if (updateForceDirection < 0) {
+            perror("writing error\n");
+            fclose(logFile);
+            exit(EXIT_FAILURE);
+        }
+
+        ticks++;
+        if (!launchOptions.realtime || ticks % rtFlushInterval == 0) {
+            fflush(logFile);
+        }
+        if (virtualClock != NULL) {
+            // The load generator's notifications are not ticks, keys wait for the next one
+            long long tickAt = virtualStart + (long long)ticks * droneTickUs * 1000;
+            while (clockSleepUntil(virtualClock, clockCommandSource, tickAt) < tickAt) {
+            }
+        } else {
+            advanceDeadline(&deadline, droneTickUs);
+            sleepUntil(&deadline);
+        }
+    }
+
+    for (int i = 0; i < plannerCount; i++) {
+        dstarFree(&planners[i]);
+    }
+    free(mission.blocked);
+    fclose(logFile);
+    return 0;
+}
@@ -1,5 +1,6 @@
 #define _POSIX_C_SOURCE 200809L
 #define _DEFAULT_SOURCE
+#define _GNU_SOURCE
 
 #include <sys/ipc.h>
 #include <sys/shm.h>
@@ -16,32 +17,18 @@
 #include <time.h>
 #include <math.h>
 #include "../include/constant.h"
-
-// Function for computing new position using Euler's Method
-double computePosition(double force, double x1, double x2) {
-    double newPosition = x1 + (force * T) - ((M * (x1 - x2)) / (M + K * T));
-    return newPosition;
-}
-
-// Function to update the drone's position based on force direction
-double updatePosition(double *position, int *forceDirection) {
-    double newPositionX = computePosition(forceDirection[0], position[4], position[2]);
-    double newPositionY = computePosition(forceDirection[1], position[5], position[3]);
-
-    // Boundary conditions
-    newPositionX = fmax(0, fmin(newPositionX, boardSize));
-    newPositionY = fmax(0, fmin(newPositionY, boardSize));
-
-    // Updating position array
-    memmove(position, position + 2, 4 * sizeof(double));
-    position[4] = newPositionX;
-    position[5] = newPositionY;
-
-    return *position;
-}
+#include "../include/supervision.h"
+#include "../include/droneModel.h"
+#include "../include/checkpoint.h"
+#include "../include/realtime.h"
+#include "../include/perfProfile.h"
+#include "../include/sharedState.h"
+#include "../include/shard.h"
+#include "../include/world.h"
+#include "../include/virtualClock.h"
 
 // Logging function
-void logData(FILE *logFile, double *position) {
+void logData(FILE *logFile, positionReal *position, unsigned long commandsReceived, unsigned long commandsCoalesced) {
     time_t rawtime;
     struct tm *info;
     char buffer[80];
@@ -50,8 +37,432 @@ void logData(FILE *logFile, double *position) {
     info = localtime(&rawtime);
 
     strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", info);
-    fprintf(logFile, "[%s] Previous position: (%.2f, %.2f) | Updated Position: (%.2f, %.2f)\n", buffer, position[2], position[3], position[4], position[5]);
+    fprintf(logFile, "[%s] Previous position: (%.2f, %.2f) | Updated Position: (%.2f, %.2f) | Commands: %lu received, %lu coalesced\n",
+            buffer, positionToDouble(position[2]), positionToDouble(position[3]), positionToDouble(position[4]),
+            positionToDouble(position[5]), commandsReceived, commandsCoalesced);
+}
+
+// Reads every queued command into forceDirection and returns how many there were. The pipe is read
+// until empty so that a backlog does not keep keyboardManager's writes waiting
+int drainCommands(int commandPipe, int forceDirection[2]) {
+    int commands[512][2];
+    int received = 0;
+    ssize_t readCommand;
+    while ((readCommand = read(commandPipe, commands, sizeof(commands))) > 0) {
+        int batch = readCommand / sizeof(commands[0]);
+        memcpy(forceDirection, commands[batch - 1], 2 * sizeof(int));
+        received += batch;
+        if (readCommand < (ssize_t)sizeof(commands)) {
+            break;
+        }
+    }
+    if (readCommand < 0 && errno != EAGAIN && errno != EINTR) {
+        perror("reading error");
+        exit(EXIT_FAILURE);
+    }
+    return received;
+}
+
+// Next random command of a swarm drone, drawn like a key press on the keyboard
+void swarmCommand(struct SwarmDrone *drone) {
+    applyMovementKey(shardRandom(&drone->random) % movementKeyCount, drone->force);
+    for (int axis = 0; axis < 2; axis++) {
+        int force = drone->force[axis];
+        drone->force[axis] = force > swarmMaxForce ? swarmMaxForce : (force < -swarmMaxForce ? -swarmMaxForce : force);
+    }
+}
+
+// Cell list over the shard's drones followed by the neighbours' ghosts, rebuilt every tick
+#define separationCells ((int)(boardSize / swarmSeparation) + 1)
+
+struct Neighbourhood {
+    int next[shardCapacity + 2 * ghostCapacity];
+    float x[shardCapacity + 2 * ghostCapacity];
+    float y[shardCapacity + 2 * ghostCapacity];
+    int heads[];        // separationCells x separationCells
+};
+
+int separationCell(float x, float y) {
+    int cx = (int)(x / swarmSeparation), cy = (int)(y / swarmSeparation);
+    cx = cx < 0 ? 0 : (cx >= separationCells ? separationCells - 1 : cx);
+    cy = cy < 0 ? 0 : (cy >= separationCells ? separationCells - 1 : cy);
+    return cy * separationCells + cx;
+}
+
+// Unit push away from every drone (own or ghost) closer than swarmSeparation
+void separationForce(struct Neighbourhood *near, int self, int *push) {
+    float x = near->x[self], y = near->y[self];
+    int cell = separationCell(x, y), cx = cell % separationCells, cy = cell / separationCells;
+    int sum[2] = {0, 0};
+    for (int dy = -1; dy <= 1; dy++) {
+        for (int dx = -1; dx <= 1; dx++) {
+            if (cx + dx < 0 || cy + dy < 0 || cx + dx >= separationCells || cy + dy >= separationCells) {
+                continue;
+            }
+            for (int j = near->heads[(cy + dy) * separationCells + cx + dx]; j >= 0; j = near->next[j]) {
+                float ox = near->x[j], oy = near->y[j];
+                if (j != self && (x - ox) * (x - ox) + (y - oy) * (y - oy) < swarmSeparation * swarmSeparation) {
+                    sum[0] += (x > ox) - (x < ox);
+                    sum[1] += (y > oy) - (y < oy);
+                }
+            }
+        }
+    }
+    push[0] = (sum[0] > 0) - (sum[0] < 0);
+    push[1] = (sum[1] > 0) - (sum[1] < 0);
+}
+
+// Taking over a drone from a neighbour, which reserved a place here for it, or passing it on if it is
+// already past this strip too and the next strip has room
+void shardAdopt(struct ShardSegment *segment, int self, struct SwarmDrone *drone, unsigned long *adopted) {
+    struct ShardRegion *region = &segment->regions[self];
+    int owner = shardOf(positionToDouble(drone->position[4]), segment->shardCount);
+    if (owner == self || !shardHandOff(segment, self, owner > self, drone)) {
+        int count = atomic_load(&region->count);
+        region->drones[count] = *drone;
+        atomic_store(&region->count, count + 1);
+        (*adopted)++;
+    }
+    atomic_fetch_sub(&region->reserved, 1);
+}
+
+// Local copy of the obstacles server keeps in the world arena, copied again only when their version changes.
+// A new copy goes to the spare buffer and replaces the current one only once it is complete, so a copy
+// that keeps failing while server rewrites the list leaves the drones colliding with the last good one.
+struct WorldView {
+    struct ArenaHeader *arena;
+    unsigned version;
+    int count;
+    struct WorldItem *items;
+    struct WorldItem buffers[2][worldMaxItems];
+};
+
+struct WorldView worldView;
+
+void worldViewRefresh(struct WorldView *view) {
+    if (view->arena == NULL) {
+        view->arena = arenaAttach(WORLD_SHM_PATH, 0); // Server may not have created it yet
+        if (view->arena == NULL) {
+            return;
+        }
+        view->items = view->buffers[0];
+    }
+    if (worldVersion(view->arena) != view->version) {
+        struct WorldItem *spare = view->items == view->buffers[0] ? view->buffers[1] : view->buffers[0];
+        int count = worldSnapshot(view->arena, spare, worldMaxItems, &view->version);
+        if (count >= 0) {
+            view->items = spare;
+            view->count = count;
+        }
+    }
+}
+
+// A step ending inside an obstacle is cancelled: the drone stays where it was and loses its velocity
+void worldCollide(struct WorldView *view, positionReal *position) {
+    if (worldBlocked(view->items, view->count, positionToDouble(position[4]), positionToDouble(position[5]))) {
+        position[4] = position[2];
+        position[5] = position[3];
+    }
+}
+
+// Checkpoint of a sharded board taken without stopping the shards. Shard 0 requests one every checkpointInterval
+// ticks; every shard saves its own drones at the start of its next tick, before it adopts or sends any, and
+// notes how far it had filled its outbound queues. Drones a neighbour sent before that note are on their way
+// and belong to the receiver's part, so the receiver stops adopting from that neighbour until the note is
+// there and then saves what is left in the queue up to it. The last shard to finish publishes the slot.
+struct ShardCheckpoint {
+    unsigned int epoch;
+    unsigned int slot;
+    int open;                  // own drones saved, part not finished yet
+    int waiting[2];            // for the note of the left / right neighbour
+    unsigned long startedAt;   // tick the part was started, a neighbour that never saves (killed) ends it
+};
+
+void shardCheckpointBegin(struct ShardCheckpoint *state, struct CheckpointFile *checkpoint,
+                          struct ShardSegment *segment, int self, unsigned long ticks) {
+    struct ShardRegion *region = &segment->regions[self];
+    state->epoch = atomic_load_explicit(&segment->checkpointEpoch, memory_order_acquire);
+    state->slot = atomic_load(&segment->checkpointSlot) & 1;
+    state->startedAt = ticks;
+    struct CheckpointSlot *slot = &checkpoint->slots[state->slot];
+    slot->droneCount[self] = 0;
+    if (self == 0) {
+        slot->tick = (unsigned long long)state->epoch * checkpointInterval;
+        slot->shardCount = segment->shardCount;
+        slot->swarmSize = segment->swarmSize;
+        memcpy(checkpoint->world[state->slot], worldView.items, worldView.count * sizeof(struct WorldItem));
+        slot->worldCount = worldView.count;
+    }
+    for (int i = 0; i < region->count; i++) {
+        checkpointAddDrone(checkpoint, state->slot, self, &region->drones[i]);
+    }
+    for (int side = 0; side < 2; side++) {
+        atomic_store_explicit(&region->checkpointHead[side], atomic_load(&region->outbound[side].head), memory_order_relaxed);
+    }
+    atomic_store_explicit(&region->checkpointEpoch, state->epoch, memory_order_release);
+    state->open = 1;
+    state->waiting[0] = self > 0;
+    state->waiting[1] = self < segment->shardCount - 1;
+}
+
+// Saving the drones still on their way from neighbours that have taken their note, and finishing the part
+void shardCheckpointCollect(struct ShardCheckpoint *state, struct CheckpointFile *checkpoint,
+                            struct ShardSegment *segment, int self, unsigned long ticks) {
+    if (!state->open) {
+        return;
+    }
+    for (int side = 0; side < 2; side++) {
+        if (!state->waiting[side]) {
+            continue;
+        }
+        struct ShardRegion *neighbour = &segment->regions[side ? self + 1 : self - 1];
+        unsigned int epoch = atomic_load_explicit(&neighbour->checkpointEpoch, memory_order_acquire);
+        unsigned int head = atomic_load_explicit(&neighbour->checkpointHead[1 - side], memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        if (epoch != state->epoch || atomic_load_explicit(&neighbour->checkpointEpoch, memory_order_relaxed) != epoch) {
+            continue;
+        }
+        struct MigrationQueue *queue = &neighbour->outbound[1 - side];
+        for (unsigned int i = atomic_load(&queue->tail); (int)(head - i) > 0; i++) {
+            checkpointAddDrone(checkpoint, state->slot, self, &queue->slots[i % migrationCapacity]);
+        }
+        state->waiting[side] = 0;
+    }
+    if (ticks - state->startedAt > checkpointInterval) {
+        state->open = 0; // a neighbour was restarted or is hung, this epoch is never published
+    } else if (!state->waiting[0] && !state->waiting[1]) {
+        checkpointFinish(checkpoint, state->epoch, state->slot, segment->shardCount);
+        state->open = 0;
+    }
+}
+
+// One strip of the sharded board (./bin/master -n): the swarm drones currently in the strip and the
+// keyboard drone while it is here. Shard 0 also reads the keyboard pipe and forwards the force through
+// the segment, so the keyboard drone is steered whichever shard owns it.
+void runShard(struct LaunchOptions *options, FILE *logFile, int commandPipe, sem_t *semaphoreID,
+              struct SharedState *sharedState, struct CheckpointFile *checkpoint,
+              positionReal *mainPosition, int *mainForce, int mainStarted) {
+    struct ShardSegment *segment = shardAttach();
+    if (segment == NULL) {
+        perror("shard segment");
+        exit(EXIT_FAILURE);
+    }
+    int self = options->shard, count = segment->shardCount;
+    struct ShardRegion *region = &segment->regions[self];
+    double left = shardLeftEdge(self, count), right = shardLeftEdge(self + 1, count);
+    ghostRecover(&region->ghosts[0]);
+    ghostRecover(&region->ghosts[1]);
+    unsigned long adopted = 0, handedOff = 0, commandsReceived = 0, commandsCoalesced = 0;
+
+    // Shard 0 puts the keyboard drone on the board once, in the place shardCreate reserved for it;
+    // a restarted shard 0 finds it already there
+    if (self == 0 && !atomic_load(&segment->mainPlaced)) {
+        struct SwarmDrone mainDrone = {.id = mainDroneId};
+        memcpy(mainDrone.position, mainPosition, sizeof(mainDrone.position));
+        memcpy(mainDrone.force, mainForce, sizeof(mainDrone.force));
+        atomic_store(&segment->forceDirection[0], mainForce[0]);
+        atomic_store(&segment->forceDirection[1], mainForce[1]);
+        atomic_store(&segment->mainStarted, mainStarted);
+        shardAdopt(segment, self, &mainDrone, &adopted);
+        atomic_store(&segment->mainPlaced, 1);
+    }
+
+    size_t headsSize = (size_t)separationCells * separationCells * sizeof(int);
+    struct Neighbourhood *near = malloc(sizeof(struct Neighbourhood) + headsSize);
+    if (near == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    positionReal published[6];
+    memset(published, 0, sizeof(published));
+
+    struct JitterStats jitter = {0};
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    unsigned long ticks = 0, updates = 0, reportedUpdates = 0;
+    double computeUs = 0;
+    struct ShardCheckpoint shardCheckpoint = {.epoch = atomic_load(&region->checkpointEpoch)};
+
+    char profileComponent[40];
+    snprintf(profileComponent, sizeof(profileComponent), "droneDynamicsShard%d", self);
+    PROFILE_DECLARE(shardProfile);
+    PROFILE_OPEN(shardProfile, logFile, profileComponent, "shardTick");
+
+    fprintf(logFile, "Shard %d/%d simulating x in [%.1f, %.1f) with %d drones\n", self, count, left, right, region->count);
     fflush(logFile);
+
+    while (1) {
+        // Keyboard commands, coalesced as in the unsharded loop and forwarded to the owner of the drone
+        if (self == 0) {
+            int commands[512][2];
+            ssize_t readCommand = read(commandPipe, commands, sizeof(commands));
+            if (readCommand > 0) {
+                int received = readCommand / sizeof(commands[0]);
+                atomic_store(&segment->forceDirection[0], commands[received - 1][0]);
+                atomic_store(&segment->forceDirection[1], commands[received - 1][1]);
+                atomic_store(&segment->mainStarted, 1);
+                atomic_fetch_add(&segment->commandSequence, 1);
+                commandsReceived += received;
+                commandsCoalesced += received - 1;
+                atomic_fetch_add_explicit(&sharedState->commandsReceived, received, memory_order_relaxed);
+                atomic_fetch_add_explicit(&sharedState->commandsCoalesced, received - 1, memory_order_relaxed);
+                statePublishForce(sharedState, commands[received - 1]);
+            } else if (readCommand < 0 && errno != EAGAIN && errno != EINTR) {
+                perror("reading error");
+                exit(EXIT_FAILURE);
+            }
+        }
+        long long begin = monotonicNs();
+        PROFILE_BEGIN(shardProfile);
+
+        // A requested checkpoint is taken before any drone is adopted or sent in this tick
+        if (checkpoint != NULL) {
+            if (atomic_load_explicit(&segment->checkpointEpoch, memory_order_acquire) != shardCheckpoint.epoch) {
+                worldViewRefresh(&worldView);
+                shardCheckpointBegin(&shardCheckpoint, checkpoint, segment, self, ticks);
+            }
+            shardCheckpointCollect(&shardCheckpoint, checkpoint, segment, self, ticks);
+        }
+
+        // Drones that crossed into this strip since the last tick, except from a neighbour whose part
+        // of the checkpoint is not saved yet
+        struct SwarmDrone incoming;
+        if (self > 0 && !shardCheckpoint.waiting[0]) {
+            while (migrationPop(&segment->regions[self - 1].outbound[1], &incoming)) {
+                shardAdopt(segment, self, &incoming, &adopted);
+            }
+        }
+        if (self < count - 1 && !shardCheckpoint.waiting[1]) {
+            while (migrationPop(&segment->regions[self + 1].outbound[0], &incoming)) {
+                shardAdopt(segment, self, &incoming, &adopted);
+            }
+        }
+
+        // Positions of this tick: own drones first, then the ghosts near both edges
+        int owned = region->count, total = owned;
+        for (int i = 0; i < owned; i++) {
+            near->x[i] = positionToDouble(region->drones[i].position[4]);
+            near->y[i] = positionToDouble(region->drones[i].position[5]);
+        }
+        if (self > 0) {
+            total += ghostRead(&segment->regions[self - 1].ghosts[1], near->x + total, near->y + total);
+        }
+        if (self < count - 1) {
+            total += ghostRead(&segment->regions[self + 1].ghosts[0], near->x + total, near->y + total);
+        }
+        memset(near->heads, -1, headsSize);
+        for (int i = 0; i < total; i++) {
+            int cell = separationCell(near->x[i], near->y[i]);
+            near->next[i] = near->heads[cell];
+            near->heads[cell] = i;
+        }
+
+        // Integrating every drone of the strip
+        worldViewRefresh(&worldView);
+        int started = atomic_load(&segment->mainStarted);
+        for (int i = 0; i < owned; i++) {
+            struct SwarmDrone *drone = &region->drones[i];
+            int force[2];
+            if (drone->id == mainDroneId) {
+                if (!started) {
+                    continue;
+                }
+                drone->force[0] = force[0] = atomic_load(&segment->forceDirection[0]);
+                drone->force[1] = force[1] = atomic_load(&segment->forceDirection[1]);
+            } else {
+                if ((ticks + drone->id) % swarmCommandTicks == 0) {
+                    swarmCommand(drone);
+                }
+                int push[2];
+                separationForce(near, i, push);
+                force[0] = drone->force[0] + push[0];
+                force[1] = drone->force[1] + push[1];
+            }
+            updatePosition(drone->position, force);
+            worldCollide(&worldView, drone->position);
+            updates++;
+        }
+
+        // Handing over the drones that left the strip; a full queue or a full neighbour keeps the drone
+        // here until the next tick
+        for (int i = region->count - 1; i >= 0; i--) {
+            int owner = shardOf(positionToDouble(region->drones[i].position[4]), count);
+            if (owner != self && shardHandOff(segment, self, owner > self, &region->drones[i])) {
+                int last = atomic_load(&region->count) - 1;
+                region->drones[i] = region->drones[last];
+                atomic_store(&region->count, last);
+                handedOff++;
+            }
+        }
+
+        // Ghost tables for the neighbours, and finding the keyboard drone if it is here
+        struct SwarmDrone *mainDrone = NULL;
+        ghostBeginWrite(&region->ghosts[0]);
+        ghostBeginWrite(&region->ghosts[1]);
+        for (int i = 0; i < region->count; i++) {
+            double x = positionToDouble(region->drones[i].position[4]);
+            double y = positionToDouble(region->drones[i].position[5]);
+            for (int side = 0; side < 2; side++) {
+                struct GhostTable *table = &region->ghosts[side];
+                int nearEdge = side == 0 ? (self > 0 && x < left + ghostWidth) : (self < count - 1 && x >= right - ghostWidth);
+                if (nearEdge && table->count < ghostCapacity) {
+                    table->x[table->count] = x;
+                    table->y[table->count] = y;
+                    table->count++;
+                }
+            }
+            if (region->drones[i].id == mainDroneId) {
+                mainDrone = &region->drones[i];
+            }
+        }
+        ghostEndWrite(&region->ghosts[0]);
+        ghostEndWrite(&region->ghosts[1]);
+        PROFILE_END(shardProfile);
+        long long computeNs = monotonicNs() - begin;
+        computeUs += computeNs / 1e3;
+        atomic_fetch_add_explicit(&region->computeNs, computeNs, memory_order_relaxed);
+        atomic_fetch_add_explicit(&region->updates, updates - reportedUpdates, memory_order_relaxed);
+        reportedUpdates = updates;
+
+        // The keyboard drone is published and logged by the shard it is in
+        if (mainDrone != NULL) {
+            if (memcmp(mainDrone->position, published, sizeof(published)) != 0) {
+                sem_wait(semaphoreID);
+                memcpy(sharedState->position, mainDrone->position, sizeof(published));
+                sem_post(semaphoreID);
+                memcpy(published, mainDrone->position, sizeof(published));
+                statePublish(sharedState);
+            }
+            logData(logFile, mainDrone->position, commandsReceived, commandsCoalesced);
+        }
+
+        // Shard 0 keeps the simulation tick of the whole board and requests the checkpoints
+        if (self == 0 && started) {
+            unsigned long long tick = atomic_fetch_add(&segment->tick, 1) + 1;
+            if (checkpoint != NULL && tick % checkpointInterval == 0) {
+                unsigned int epoch = tick / checkpointInterval;
+                atomic_store(&segment->checkpointSlot, 1 - atomic_load(&checkpoint->active));
+                checkpointBegin(checkpoint, epoch);
+                atomic_store_explicit(&segment->checkpointEpoch, epoch, memory_order_release);
+            }
+        }
+
+        ticks++;
+        if (ticks % jitterReportInterval == 0) {
+            fprintf(logFile, "Shard %d/%d: %d drones, %lu updates in %.2f ms of compute (%.3g updates/s), "
+                    "%lu drones adopted, %lu handed off, %d ghosts\n", self, count, region->count, updates,
+                    computeUs / 1e3, computeUs > 0 ? updates / (computeUs / 1e6) : 0.0, adopted, handedOff, total - owned);
+            jitterReport(&jitter, logFile, options->realtime);
+            updates = reportedUpdates = adopted = handedOff = 0;
+            computeUs = 0;
+        }
+        if (!options->realtime || ticks % rtFlushInterval == 0) {
+            fflush(logFile);
+        }
+
+        advanceDeadline(&deadline, droneTickUs);
+        jitterRecord(&jitter, sleepUntil(&deadline));
+    }
 }
 
 int main(int argc, char *argv[]) {
@@ -62,9 +473,13 @@ int main(int argc, char *argv[]) {
     sigaction(SIGINT, &signal_action, NULL);
     sigaction(SIGUSR1, &signal_action, NULL);
 
-    // Pipes
+    struct LaunchOptions launchOptions;
+    parseLaunchOptions(argc, argv, &launchOptions);
+    int sharded = launchOptions.shards > 1;
+
+    // Pipes; every shard registers with the watchdog, only shard 0 reads the keyboard
     int pipeKeyboardDrone[2], pipeWatchdogDrone[2];
-    pid_t dronePID = getpid();
+    struct DronePID dronePID = {launchOptions.shard, getpid()};
     sscanf(argv[1], "%d %d|%d %d", &pipeKeyboardDrone[0], &pipeKeyboardDrone[1], &pipeWatchdogDrone[0], &pipeWatchdogDrone[1]);
     close(pipeKeyboardDrone[1]);
     close(pipeWatchdogDrone[0]);  // Closing unnecessary pipes
@@ -75,9 +490,10 @@ int main(int argc, char *argv[]) {
     int flags = fcntl(pipeKeyboardDrone[0], F_GETFL);
     fcntl(pipeKeyboardDrone[0], F_SETFL, flags | O_NONBLOCK);
 
-    int forceDirection[2]; // force direction of x and y coordinates
-    double position[6];
+    int forceDirection[2] = {0, 0}; // force direction of x and y coordinates
+    positionReal position[6];
     int initial = 0;
+    unsigned long commandsReceived = 0, commandsCoalesced = 0;
 
     // Shared memory setup
     int sharedSegSize = (1 * sizeof(position));
@@ -93,54 +509,188 @@ int main(int argc, char *argv[]) {
         exit(EXIT_FAILURE);
     }
 
-    void *shmPointer = mmap(NULL, sharedSegSize, PROT_READ | PROT_WRITE, MAP_SHARED, shmFD, 0);
+    void *shmPointer = mmap(NULL, SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, shmFD, 0);
     if (shmPointer == MAP_FAILED) {
         perror("mmap");
         exit(EXIT_FAILURE);
     }
+    struct SharedState *sharedState = shmPointer;
 
     // Open the log file
     FILE *logFile;
     char logFilePath[100];
-    snprintf(logFilePath, sizeof(logFilePath), "log/droneDynamicsLog.txt");
-    logFile = fopen(logFilePath, "w");
+    if (launchOptions.shard == 0) {
+        snprintf(logFilePath, sizeof(logFilePath), "log/droneDynamicsLog.txt");
+    } else {
+        snprintf(logFilePath, sizeof(logFilePath), "log/droneDynamicsShard%dLog.txt", launchOptions.shard);
+    }
+    logFile = fopen(logFilePath, launchOptions.restartedAt ? "a" : "w");
 
     if (logFile == NULL) {
         perror("Error opening log file");
         exit(EXIT_FAILURE);
     }
 
+    // A restarted drone resumes from the last published state and the last applied command
+    // instead of waiting for the first input
+    if (launchOptions.restartedAt) {
+        sem_wait(semaphoreID);
+        memcpy(position, shmPointer, sharedSegSize);
+        sem_post(semaphoreID);
+        stateForce(sharedState, forceDirection);
+        initial = 1;
+    }
+    // Resuming a planned restart from the last checkpoint
+    struct CheckpointSlot restored;
+    unsigned long long tick = 0;
+    if (launchOptions.restore && !launchOptions.restartedAt) {
+        if (checkpointRestore(CHECKPOINT_PATH, &restored)) {
+            memcpy(position, restored.position, sizeof(position));
+            memcpy(forceDirection, restored.forceDirection, sizeof(forceDirection));
+            tick = restored.tick;
+            initial = 1;
+            fprintf(logFile, "Restored checkpoint of tick %llu\n", tick);
+        } else {
+            fprintf(logFile, "No valid checkpoint in %s, starting from the initial position\n", CHECKPOINT_PATH);
+        }
+        fflush(logFile);
+    }
+    statePublishForce(sharedState, forceDirection);
+    logRecovery(logFile, "DroneDynamics", &launchOptions);
+
+    // A fresh drone starts from the position the window publishes; without a window (load generator)
+    // it gives up after stateWaitTimeoutUs and starts from whatever the segment holds
+    unsigned generation = stateGeneration(sharedState);
+    if (!initial && generation == 0) {
+        generation = stateWait(sharedState, 0, stateWaitTimeoutUs);
+    }
+    unsigned copiedGeneration = generation - 1; // forces the first copy
+    positionReal published[6];
+    memset(published, 0, sizeof(published));
+
+    struct CheckpointFile *checkpoint = checkpointOpen(CHECKPOINT_PATH);
+    if (checkpoint == NULL) {
+        perror("checkpoint");
+    }
+
+    // Real-time profile: no page faults and no per-tick write() for the log on the hot path
+    if (launchOptions.realtime) {
+        setvbuf(logFile, NULL, _IOFBF, 1 << 16);
+        applyRealtimeMemory(logFile, shmPointer, sharedSegSize);
+    }
+
+    if (sharded) {
+        if (!initial) {
+            sem_wait(semaphoreID);
+            memcpy(position, shmPointer, sharedSegSize);
+            sem_post(semaphoreID);
+        }
+        runShard(&launchOptions, logFile, pipeKeyboardDrone[0], semaphoreID, sharedState, checkpoint,
+                 position, forceDirection, initial);
+    }
+
+    // With the virtual clock (./bin/master -v) every tick is a turn of the shared clock instead of a deadline
+    struct VirtualClock *virtualClock = NULL;
+    long long virtualStart = 0;
+    if (launchOptions.virtualClock) {
+        virtualClock = clockAttach();
+        if (virtualClock == NULL) {
+            perror("virtual clock");
+            exit(EXIT_FAILURE);
+        }
+        virtualStart = clockJoin(virtualClock, clockDrone);
+    }
+
+    // The loop runs on absolute deadlines so that neither the work nor the watchdog's signals shift the period
+    struct JitterStats jitter = {0};
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    unsigned long ticks = 0;
+    int drainedEarly = 0;
+
+    PROFILE_DECLARE(tickProfile);
+    PROFILE_OPEN(tickProfile, logFile, "droneDynamics", "tick");
+
     while (1) {
-        // Receive command force from keyboard_manager
-        ssize_t readCommand = read(pipeKeyboardDrone[0], forceDirection, sizeof(forceDirection));
+        // The whole tick is profiled up to the sleep, as a shard's tick and window's frame are
+        PROFILE_BEGIN(tickProfile);
+
+        // Receive command force from keyboard_manager; every command carries the full force state,
+        // so when several are queued only the latest one is applied and the rest are coalesced
+        int received = drainCommands(pipeKeyboardDrone[0], forceDirection) + drainedEarly;
+        drainedEarly = 0;
+        commandsReceived += received;
+        atomic_fetch_add_explicit(&sharedState->commandsReceived, received, memory_order_relaxed);
+        if (received > 0) {
+            statePublishForce(sharedState, forceDirection);
+        }
+        if (received > 1) {
+            commandsCoalesced += received - 1;
+            atomic_fetch_add_explicit(&sharedState->commandsCoalesced, received - 1, memory_order_relaxed);
+        }
+
+        worldViewRefresh(&worldView);
 
         // Wait until the user's initial input
         if (initial == 0) {
-            sem_wait(semaphoreID);
-            memcpy(position, shmPointer, sharedSegSize); // Get the initial position of the drone from window.c
-            sem_post(semaphoreID);
+            generation = stateGeneration(sharedState);
+            if (generation != copiedGeneration) {
+                sem_wait(semaphoreID);
+                memcpy(position, shmPointer, sharedSegSize); // Get the initial position of the drone from window.c
+                sem_post(semaphoreID);
+                memcpy(published, position, sizeof(published));
+                copiedGeneration = generation;
+            }
 
-            if (readCommand < 0) {
-                if (errno != EAGAIN) {
-                    perror("reading error");
-                    exit(EXIT_FAILURE);
-                }
-            } else if (readCommand > 0) { // User's initial input
+            if (received > 0) { // User's initial input
                 updatePosition(position, forceDirection);
+                worldCollide(&worldView, position);
                 initial++;
             }
         } else { // For next inputs
             updatePosition(position, forceDirection);
+            worldCollide(&worldView, position);
         }
 
-        // Sending updated drone position to window via shared memory
-        sem_wait(semaphoreID);
-        memcpy(shmPointer, position, sharedSegSize);
-        sem_post(semaphoreID);
+        // Sending updated drone position to window via shared memory; a drone at rest publishes nothing,
+        // so the consumers blocked on the generation are not woken for an identical state
+        if (memcmp(position, published, sizeof(published)) != 0) {
+            sem_wait(semaphoreID);
+            memcpy(shmPointer, position, sharedSegSize);
+            sem_post(semaphoreID);
+            memcpy(published, position, sizeof(published));
+            statePublish(sharedState);
+            copiedGeneration = stateGeneration(sharedState);
+        }
+
+        // Periodic checkpoint, only once the drone has actually started moving
+        if (initial && checkpoint != NULL && ++tick % checkpointInterval == 0) {
+            checkpointWrite(checkpoint, tick, position, forceDirection, worldView.items, worldView.count);
+        }
 
         // Write to the log file
-        logData(logFile, position);
-        usleep(300000);
+        logData(logFile, position, commandsReceived, commandsCoalesced);
+        ticks++;
+        if (!launchOptions.realtime || ticks % rtFlushInterval == 0) {
+            fflush(logFile);
+        }
+        PROFILE_END(tickProfile);
+
+        if (virtualClock != NULL) {
+            // keyboardManager hands over its turn when the pipe is full: the commands are drained for the
+            // next tick and the turn goes back to it, the tick itself still runs on schedule
+            long long tickAt = virtualStart + (long long)ticks * droneTickUs * 1000;
+            while (clockSleepUntil(virtualClock, clockDrone, tickAt) < tickAt) {
+                drainedEarly += drainCommands(pipeKeyboardDrone[0], forceDirection);
+                clockNotify(virtualClock, clockCommandSource);
+            }
+        } else {
+            advanceDeadline(&deadline, droneTickUs);
+            jitterRecord(&jitter, sleepUntil(&deadline));
+        }
+        if (ticks % jitterReportInterval == 0) {
+            jitterReport(&jitter, logFile, launchOptions.realtime);
+        }
     }
 
     // Cleaning up
@@ -1,4 +1,5 @@
 #define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -15,8 +16,44 @@
 #include <signal.h>
 #include <signal.h>
 #include "../include/constant.h"
+#include "../include/droneModel.h"
+#include "../include/supervision.h"
+#include "../include/realtime.h"
+#include "../include/virtualClock.h"
+#include "../include/checkpoint.h"
 #include <errno.h>
 
+// Writing the force-direction to the drone. Retrying on EINTR: under load the pipe fills up and the
+// watchdog's signals interrupt the blocked write. With the virtual clock the write does not block; a
+// full pipe hands the turn to the drone, which drains it and gives the turn back
+void sendForce(int pipeDrone, int forceDirection[2], struct VirtualClock *virtualClock, FILE *logFile) {
+    int updateForceDirection;
+    while (1) {
+        updateForceDirection = write(pipeDrone, forceDirection, 2 * sizeof(int));
+        if (updateForceDirection == -1 && errno == EAGAIN && virtualClock != NULL) {
+            clockNotify(virtualClock, clockDrone);
+            clockSleepUntil(virtualClock, clockCommandSource, clockNever);
+        } else if (updateForceDirection != -1 || errno != EINTR) {
+            break;
+        }
+    }
+    if (updateForceDirection < 0) {
+        fclose(logFile);
+        close(pipeDrone); //closing unnecessary pipes
+        perror("writing error\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Counted in the shared state, where the load generator compares it with what the drone has read
+    static struct SharedState *sharedState = NULL;
+    if (sharedState == NULL) {
+        sharedState = stateAttach(SHM_PATH);
+    }
+    if (sharedState != NULL) {
+        atomic_fetch_add_explicit(&sharedState->commandsSent, 1, memory_order_relaxed);
+    }
+}
+
 int main(int argc, char *argv[]) {
     // Pipes
     int pipeKeyboardDrone[2], pipeWindowKeyboard[2], pipeWatchdogKeyboard[2];
@@ -30,6 +67,9 @@ int main(int argc, char *argv[]) {
     write(pipeWatchdogKeyboard[1], &keyboardPID, sizeof(keyboardPID));
     close(pipeWatchdogKeyboard[1]);
 
+    struct LaunchOptions launchOptions;
+    parseLaunchOptions(argc, argv, &launchOptions);
+
     // Signal handeling for watchdog
     struct sigaction signal_action;
     signal_action.sa_sigaction = handleSignal;
@@ -41,15 +81,58 @@ int main(int argc, char *argv[]) {
     FILE *logFile;
     char logFilePath[100];
     snprintf(logFilePath, sizeof(logFilePath), "log/keyboardLog.txt");
-    logFile = fopen(logFilePath, "w"); // "a" mode appends to the file
+    logFile = fopen(logFilePath, launchOptions.restartedAt ? "a" : "w"); // "a" mode appends to the file
 
     if (logFile == NULL) {
         perror("Error opening log file\n");
         exit(EXIT_FAILURE);
     }
+    logRecovery(logFile, "KeyboardManager", &launchOptions);
+
+    // Real-time profile: lock memory and stop flushing the log after every key
+    if (launchOptions.realtime) {
+        setvbuf(logFile, NULL, _IOFBF, 1 << 16);
+        applyRealtimeMemory(logFile, NULL, 0);
+    }
+    unsigned long keysLogged = 0;
+
+    // With the virtual clock the keys are read without blocking and every turn drains the pipe;
+    // the load generator hands over a turn after each batch it writes
+    struct VirtualClock *virtualClock = NULL;
+    if (launchOptions.virtualClock) {
+        virtualClock = clockAttach();
+        if (virtualClock == NULL) {
+            perror("virtual clock");
+            exit(EXIT_FAILURE);
+        }
+        int flags = fcntl(pipeWindowKeyboard[0], F_GETFL);
+        fcntl(pipeWindowKeyboard[0], F_SETFL, flags | O_NONBLOCK);
+        flags = fcntl(pipeKeyboardDrone[1], F_GETFL);
+        fcntl(pipeKeyboardDrone[1], F_SETFL, flags | O_NONBLOCK);
+    }
 
     int key;
     int forceDirection[2] = {0, 0};
+    // Every command carries the full force, so a restored run continues from the checkpointed force
+    // that droneDynamics resumes with instead of overwriting it with the first key
+    struct CheckpointSlot restored;
+    if (launchOptions.restore && !launchOptions.restartedAt && checkpointRestore(CHECKPOINT_PATH, &restored)) {
+        memcpy(forceDirection, restored.forceDirection, sizeof(forceDirection));
+        fprintf(logFile, "Restored force direction [%d, %d] from checkpoint of tick %llu\n",
+                forceDirection[0], forceDirection[1], restored.tick);
+        fflush(logFile);
+    }
+    // A restarted keyboardManager continues from the force droneDynamics last applied, so that the next
+    // key changes it instead of replacing it with a single step from rest
+    if (launchOptions.restartedAt) {
+        struct SharedState *sharedState = stateAttach(SHM_PATH);
+        if (sharedState != NULL) {
+            stateForce(sharedState, forceDirection);
+            fprintf(logFile, "Resumed force direction [%d, %d] after restart\n", forceDirection[0], forceDirection[1]);
+            fflush(logFile);
+        }
+    }
+    int pendingCommand = 0; // virtual clock: a force not yet sent to the drone in this turn
 
     while (1) {
         ssize_t keyPress;
@@ -57,6 +140,15 @@ int main(int argc, char *argv[]) {
         do {
             keyPress = read(pipeWindowKeyboard[0], &key, sizeof(key));
         } while (keyPress == -1 && errno == EINTR);
+        if (keyPress == -1 && errno == EAGAIN && virtualClock != NULL) {
+            // Every command carries the full force state, so a turn sends only the latest one
+            if (pendingCommand) {
+                sendForce(pipeKeyboardDrone[1], forceDirection, virtualClock, logFile);
+                pendingCommand = 0;
+            }
+            clockSleepUntil(virtualClock, clockCommandSource, clockNever);
+            continue;
+        }
 
         if (keyPress < 0) {
             perror("reading error\n");
@@ -70,44 +162,30 @@ int main(int argc, char *argv[]) {
         // Updateing force-direction based on user input
         switch ((char) key) {
             case 'q': // Enter q to exit
+                if (virtualClock != NULL) {
+                    clockDetach(virtualClock, clockCommandSource);
+                }
                 close(pipeWindowKeyboard[0]);
                 close(pipeKeyboardDrone[1]);
                 fclose(logFile);
                 exit(EXIT_SUCCESS);
 
-            case 's':
-                forceDirection[0]--; break;
-            case 'r':
-                forceDirection[0]++; forceDirection[1]--; break;
-            case 'e':
-                forceDirection[1]--; break;
-            case 'x':
-                forceDirection[0]--; forceDirection[1]++; break;
-            case 'd':
-                forceDirection[0] = 0; forceDirection[1] = 0; break;  // Stop (no movement)
-            case 'c':
-                forceDirection[1]++; break;
-            case 'w':
-                forceDirection[0]--; forceDirection[1]--; break;
-            case 'f':
-                forceDirection[0]++; break;
-            case 'v':
-                forceDirection[0]++; forceDirection[1]++; break;
+            default: // Movement keys, 'd' stops the drone
+                applyKey((char) key, forceDirection); break;
         }
 
         // Sending the updated force-direction to drone.c
-        int updateForceDirection = write(pipeKeyboardDrone[1], forceDirection, sizeof(forceDirection));
-        if (updateForceDirection < 0) {
-            fclose(logFile);
-            close(pipeWindowKeyboard[0]); 
-            close(pipeKeyboardDrone[1]); //closing unnecessary pipes
-            perror("writing error\n");
-            exit(EXIT_FAILURE);
+        if (virtualClock != NULL) {
+            pendingCommand = 1;
+        } else {
+            sendForce(pipeKeyboardDrone[1], forceDirection, NULL, logFile);
         }
 
         // Writing to the log file
         fprintf(logFile, "Key Press: %c, Force Direction: [%d, %d]\n", (char) key, forceDirection[0], forceDirection[1]);
-        fflush(logFile);
+        if (!launchOptions.realtime || ++keysLogged % rtFlushInterval == 0) {
+            fflush(logFile);
+        }
     }
 
     // Closing the log file
@@ -0,0 +1,329 @@
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <math.h>
+#include <sys/ioctl.h>
+#include <sys/types.h>
+#include "../include/constant.h"
+#include "../include/droneModel.h"
+#include "../include/supervision.h"
+#include "../include/virtualClock.h"
+
+// Largest batch written with a single write(); one PIPE_BUF worth of keys keeps every write atomic
+#define maxBatch (4096 / sizeof(int))
+
+enum keyDistribution { DIST_UNIFORM, DIST_HOTKEY, DIST_SEQUENCE };
+enum arrivalPattern { ARRIVAL_CONSTANT, ARRIVAL_POISSON };
+
+double nowSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Number of bytes currently queued in a pipe (works on either end of the pipe)
+int queuedBytes(int fd) {
+    int bytes = 0;
+    if (ioctl(fd, FIONREAD, &bytes) == -1) {
+        return 0;
+    }
+    return bytes;
+}
+
+// Commands droneDynamics has read so far (into done), how many of them it coalesced away (into coalesced)
+// and commands keyboardManager has written that it has not read yet (returned), from the counters in the
+// shared state; server may not have created it yet
+int droneCommands(struct SharedState **sharedState, unsigned long long *done, unsigned long long *coalesced) {
+    *done = *coalesced = 0;
+    if (*sharedState == NULL) {
+        *sharedState = stateAttach(SHM_PATH);
+        if (*sharedState == NULL) {
+            return 0;
+        }
+    }
+    unsigned long sentCommands = atomic_load_explicit(&(*sharedState)->commandsSent, memory_order_relaxed);
+    *done = atomic_load_explicit(&(*sharedState)->commandsReceived, memory_order_relaxed);
+    *coalesced = atomic_load_explicit(&(*sharedState)->commandsCoalesced, memory_order_relaxed);
+    return sentCommands > *done ? (int)(sentCommands - *done) : 0;
+}
+
+// Picking the next key according to the configured distribution
+int nextKey(enum keyDistribution distribution, unsigned long long index) {
+    int count = movementKeyCount; // 'q' is never generated, it ends the run
+    switch (distribution) {
+        case DIST_HOTKEY: // 80% of the events hit the same key, the rest are uniform
+            if (rand() % 100 < 80) {
+                return movementKeys[0];
+            }
+            return movementKeys[rand() % count];
+        case DIST_SEQUENCE:
+            return movementKeys[index % count];
+        case DIST_UNIFORM:
+        default:
+            return movementKeys[rand() % count];
+    }
+}
+
+// Gap until the next arrival for the configured pattern
+double nextGap(enum arrivalPattern pattern, double rate) {
+    if (pattern == ARRIVAL_POISSON) {
+        double u = (rand() + 1.0) / ((double)RAND_MAX + 2.0);
+        return -log(u) / rate;
+    }
+    return 1.0 / rate;
+}
+
+// Moving an arrival that falls in the silent part of a burst cycle to the start of the next burst
+double skipSilence(double t, double burstOn, double burstOff) {
+    if (burstOff <= 0) {
+        return t;
+    }
+    double period = burstOn + burstOff;
+    double phase = fmod(t, period);
+    if (phase >= burstOn) {
+        t += period - phase;
+    }
+    return t;
+}
+
+void usage(const char *name) {
+    fprintf(stderr, "usage: %s <pipes> <launch options> [-r rate] [-t seconds] [-d uniform|hotkey|sequence] "
+                    "[-p constant|poisson] [-b onMs/offMs] [-s seed] [-B]\n", name);
+}
+
+int main(int argc, char *argv[]) {
+    // Signal handling for watchdog
+    struct sigaction sig_act;
+    sig_act.sa_sigaction = handleSignal;
+    sig_act.sa_flags = SA_SIGINFO;
+    sigemptyset(&sig_act.sa_mask);
+    sigaction(SIGINT, &sig_act, NULL);
+    sigaction(SIGUSR1, &sig_act, NULL);
+
+    if (argc < 3) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    // Pipes: the generator takes the place of window.c. The keyboard -> drone pipe is not its to keep
+    // open: droneDynamics must see EOF once keyboardManager is gone; its queue is followed through the
+    // command counters in the shared state instead
+    int pipeWindowKeyboard[2], pipeWatchdogWindow[2], pipeKeyboardDrone[2];
+    sscanf(argv[1], "%d %d|%d %d|%d %d", &pipeWindowKeyboard[0], &pipeWindowKeyboard[1],
+           &pipeWatchdogWindow[0], &pipeWatchdogWindow[1], &pipeKeyboardDrone[0], &pipeKeyboardDrone[1]);
+    close(pipeWatchdogWindow[0]);
+    close(pipeKeyboardDrone[0]);
+    close(pipeKeyboardDrone[1]);
+
+    struct LaunchOptions launchOptions;
+    parseLaunchOptions(argc, argv, &launchOptions);
+
+    // Options (argv[1] holds the pipes and argv[2] the launch options from master)
+    double rate = 1000.0, duration = 10.0, burstOn = 0.0, burstOff = 0.0;
+    enum keyDistribution distribution = DIST_UNIFORM;
+    enum arrivalPattern pattern = ARRIVAL_CONSTANT;
+    unsigned int seed = (unsigned int)time(NULL);
+    int blocking = 0;
+    int opt;
+    optind = 3;
+    while ((opt = getopt(argc, argv, "r:t:d:p:b:s:B")) != -1) {
+        switch (opt) {
+            case 'r':
+                rate = atof(optarg); break;
+            case 't':
+                duration = atof(optarg); break;
+            case 'd':
+                if (strcmp(optarg, "hotkey") == 0) distribution = DIST_HOTKEY;
+                else if (strcmp(optarg, "sequence") == 0) distribution = DIST_SEQUENCE;
+                else distribution = DIST_UNIFORM;
+                break;
+            case 'p':
+                pattern = strcmp(optarg, "poisson") == 0 ? ARRIVAL_POISSON : ARRIVAL_CONSTANT;
+                break;
+            case 'b':
+                if (sscanf(optarg, "%lf/%lf", &burstOn, &burstOff) != 2) {
+                    usage(argv[0]);
+                    exit(EXIT_FAILURE);
+                }
+                burstOn /= 1000.0;
+                burstOff /= 1000.0;
+                break;
+            case 's':
+                seed = (unsigned int)strtoul(optarg, NULL, 10); break;
+            case 'B':
+                blocking = 1; break;
+            default:
+                usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (rate <= 0 || duration <= 0) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    srand(seed);
+
+    // Sending PID to watchdog in place of window
+    pid_t generatorPID = getpid();
+    if (write(pipeWatchdogWindow[1], &generatorPID, sizeof(generatorPID)) == -1) {
+        perror("write pipeWatchdogWindow");
+        exit(EXIT_FAILURE);
+    }
+    close(pipeWatchdogWindow[1]);
+
+    // In the default mode a full pipe is a drop, with -B the generator is throttled by back-pressure instead
+    if (!blocking) {
+        int flags = fcntl(pipeWindowKeyboard[1], F_GETFL);
+        fcntl(pipeWindowKeyboard[1], F_SETFL, flags | O_NONBLOCK);
+    }
+
+    // Open the log file
+    FILE *logFile = fopen("log/loadGeneratorLog.txt", launchOptions.restartedAt ? "a" : "w");
+    if (logFile == NULL) {
+        perror("Error opening log file");
+        exit(EXIT_FAILURE);
+    }
+    logRecovery(logFile, "LoadGenerator", &launchOptions);
+    fprintf(logFile, "rate=%.0f/s duration=%.1fs distribution=%d pattern=%d burst=%.0f/%.0fms seed=%u blocking=%d\n",
+            rate, duration, distribution, pattern, burstOn * 1000, burstOff * 1000, seed, blocking);
+    fprintf(logFile, "time(s) offered sent dropped kbQueue kbThroughput(/s) droneQueue droneThroughput(/s) droneCoalesced\n");
+    fflush(logFile);
+
+    // With the virtual clock (./bin/master -v) arrivals are scheduled in simulated time and every batch
+    // hands a turn to keyboardManager; elapsed is then simulated time as well
+    struct VirtualClock *virtualClock = NULL;
+    long long virtualStart = 0;
+    if (launchOptions.virtualClock) {
+        virtualClock = clockAttach();
+        if (virtualClock == NULL) {
+            perror("virtual clock");
+            exit(EXIT_FAILURE);
+        }
+        virtualStart = clockJoin(virtualClock, clockKeySource);
+    }
+
+    int batch[maxBatch];
+    unsigned long long offered = 0, sent = 0, dropped = 0, generated = 0;
+    unsigned long long lastSent = 0, lastKbDone = 0, lastDroneDone = 0, lastDroneCoalesced = 0;
+    int maxKbQueue = 0, maxDroneQueue = 0;
+    struct SharedState *sharedState = NULL;
+    double start = nowSeconds();
+    double nextArrival = skipSilence(0.0, burstOn, burstOff);
+    double lastReport = 0.0;
+
+    while (1) {
+        double elapsed = virtualClock != NULL ? (clockNow(virtualClock) - virtualStart) / 1e9 : nowSeconds() - start;
+        if (elapsed >= duration) {
+            break;
+        }
+
+        // Collecting every arrival that is already due into one batch
+        size_t count = 0;
+        while (count < maxBatch && nextArrival <= elapsed) {
+            batch[count++] = nextKey(distribution, generated++);
+            nextArrival = skipSilence(nextArrival + nextGap(pattern, rate), burstOn, burstOff);
+        }
+
+        if (count > 0) {
+            offered += count;
+            ssize_t written;
+            do {
+                written = write(pipeWindowKeyboard[1], batch, count * sizeof(int));
+            } while (written == -1 && errno == EINTR);
+
+            if (written < 0) {
+                if (errno != EAGAIN) {
+                    perror("writing error");
+                    exit(EXIT_FAILURE);
+                }
+                dropped += count;
+            } else {
+                sent += written / sizeof(int);
+                dropped += count - written / sizeof(int);
+            }
+            if (virtualClock != NULL) {
+                clockNotify(virtualClock, clockCommandSource);
+            }
+        } else if (virtualClock != NULL) {
+            // Rounded up so that the arrival is due when the turn comes, and always in the future
+            long long now = clockNow(virtualClock), arrival = virtualStart + (long long)ceil(nextArrival * 1e9);
+            clockSleepUntil(virtualClock, clockKeySource, arrival > now ? arrival : now + 1);
+        } else {
+            // Nothing due: sleep for long gaps, spin for short ones
+            double wait = nextArrival - elapsed;
+            if (wait > 0.0002) {
+                usleep((useconds_t)((wait - 0.0001) * 1e6));
+            }
+        }
+
+        // Per-interval report of every stage
+        if (elapsed - lastReport >= 1.0) {
+            int kbQueue = queuedBytes(pipeWindowKeyboard[0]) / sizeof(int);
+            unsigned long long kbDone = sent - kbQueue;
+            unsigned long long droneDone, droneCoalesced;
+            int droneQueue = droneCommands(&sharedState, &droneDone, &droneCoalesced);
+            double interval = elapsed - lastReport;
+
+            if (kbQueue > maxKbQueue) maxKbQueue = kbQueue;
+            if (droneQueue > maxDroneQueue) maxDroneQueue = droneQueue;
+
+            fprintf(logFile, "%.2f %llu %llu %llu %d %.0f %d %.0f %llu\n", elapsed, offered, sent, dropped,
+                    kbQueue, (kbDone - lastKbDone) / interval, droneQueue, (droneDone - lastDroneDone) / interval,
+                    droneCoalesced - lastDroneCoalesced);
+            fflush(logFile);
+            printf("[%.1fs] sent %.0f/s dropped %llu | keyboard queue %d, %.0f/s | drone queue %d, %.0f/s, %llu coalesced\n",
+                   elapsed, (sent - lastSent) / interval, dropped, kbQueue, (kbDone - lastKbDone) / interval,
+                   droneQueue, (droneDone - lastDroneDone) / interval, droneCoalesced - lastDroneCoalesced);
+            fflush(stdout);
+
+            lastSent = sent;
+            lastKbDone = kbDone;
+            lastDroneDone = droneDone;
+            lastDroneCoalesced = droneCoalesced;
+            lastReport = elapsed;
+        }
+    }
+
+    // Final summary over the whole run
+    double elapsed = virtualClock != NULL ? (clockNow(virtualClock) - virtualStart) / 1e9 : nowSeconds() - start;
+    int kbQueue = queuedBytes(pipeWindowKeyboard[0]) / sizeof(int);
+    unsigned long long kbDone = sent - kbQueue;
+    unsigned long long droneDone, droneCoalesced;
+    droneCommands(&sharedState, &droneDone, &droneCoalesced);
+
+    fprintf(logFile, "SUMMARY elapsed=%.2fs offered=%llu sent=%llu dropped=%llu sentRate=%.0f/s "
+                     "kbRate=%.0f/s kbMaxQueue=%d droneRate=%.0f/s droneMaxQueue=%d droneCoalesced=%llu\n",
+            elapsed, offered, sent, dropped, sent / elapsed, kbDone / elapsed, maxKbQueue,
+            droneDone / elapsed, maxDroneQueue, droneCoalesced);
+    fflush(logFile);
+    printf("Offered %llu, sent %llu (%.0f/s), dropped %llu\n", offered, sent, sent / elapsed, dropped);
+    printf("keyboardManager: %.0f/s, max queue %d | droneDynamics: %.0f/s, max queue %d, %llu coalesced\n",
+           kbDone / elapsed, maxKbQueue, droneDone / elapsed, maxDroneQueue, droneCoalesced);
+    fflush(stdout);
+
+    // Ending the run the same way a user would
+    int flags = fcntl(pipeWindowKeyboard[1], F_GETFL);
+    fcntl(pipeWindowKeyboard[1], F_SETFL, flags & ~O_NONBLOCK);
+    int quit = 'q';
+    if (write(pipeWindowKeyboard[1], &quit, sizeof(quit)) == -1) {
+        perror("writing error");
+    }
+
+    if (virtualClock != NULL) {
+        clockNotify(virtualClock, clockCommandSource);
+        clockDetach(virtualClock, clockKeySource);
+    }
+
+    close(pipeWindowKeyboard[1]);
+    fclose(logFile);
+
+    return 0;
+}
@@ -1,10 +1,55 @@
+#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <errno.h>
 #include <sys/wait.h>
 #include <time.h>
-#include <signal.h> 
+#include <signal.h>
+#include <pthread.h>
 #include "../include/constant.h"
+#include "../include/supervision.h"
+#include "../include/realtime.h"
+#include "../include/shard.h"
+#include "../include/checkpoint.h"
+#include "../include/virtualClock.h"
+
+// Pipe descriptors for communication between processes; master keeps every end open
+// so that a restarted component can be reattached to the same channels
+int pipeWindowKeyboard[2];
+int pipeKeyboardDrone[2];
+int pipeWatchdogServer[2];
+int pipeWatchdogWindow[2];
+int pipeWatchdogKeyboard[2];
+int pipeWatchdogDrone[2];
+
+// Array to store PIDs of all processes
+pid_t allPID[numberOfProcesses];
+
+// Command line state
+int loadGenerator = 0;
+int supervise = 0;
+int restore = 0;
+int realtime = 0;
+char *mission = NULL;
+char *worldFile = NULL;
+int shards = 1;
+int swarmSize = 0;
+int virtualTime = 0;
+
+// Extra droneDynamics instances when the board is sharded; shard 0 is allPID[3]
+pid_t shardPID[maxShards];
+int extraArgc = 0;
+char **extraArgv = NULL;
+
+// Set when the watchdog asks for a full shutdown
+volatile sig_atomic_t shutdownRequested = 0;
+
+void handleShutdown(int signo) {
+    shutdownRequested = 1;
+}
 
 // Function to execute a program with specified arguments and handle errors
 void summon(char **programArgs, int fd1, int fd2, int displayKonsole) {
@@ -20,10 +65,166 @@ void summon(char **programArgs, int fd1, int fd2, int displayKonsole) {
     exit(EXIT_FAILURE);
 }
 
-int main() {
-    // Pipe descriptors for communication between processes
-    int pipeWindowKeyboard[2];
-    int pipeKeyboardDrone[2];
+// Function to fork and launch the i-th process, restartedAt is 0 on the first launch;
+// shard selects the strip for droneDynamics (i == 3) and is 0 otherwise
+pid_t launch(int i, int shard, long long restartedAt) {
+    struct LaunchOptions options = {restartedAt, supervise, getpid(), restore, realtime, shard, shards, virtualTime};
+    char launchArgs[maxMsgLength];
+    formatLaunchOptions(launchArgs, sizeof(launchArgs), &options);
+
+    pid_t pid = fork();
+    char args[maxMsgLength];
+
+    if (pid == 0) { // Child process
+        if (realtime) {
+            char *names[numberOfProcesses] = {"Server", "Window", "KeyboardManager", "DroneDynamics", "Watchdog"};
+            applyRealtimeScheduling(i, shard, names[i]);
+        }
+        switch (i) {
+            case 0:
+                // Server process
+                sprintf(args, "%d %d", pipeWatchdogServer[0], pipeWatchdogServer[1]);
+                char *argsServer[] = {"./bin/server", args, launchArgs, worldFile, NULL};
+                summon(argsServer, 0, 0, 0);
+                break;
+            case 1:
+                if (loadGenerator) {
+                    // Load generator in place of the window, it also samples the keyboard -> drone pipe
+                    sprintf(args, "%d %d|%d %d|%d %d", pipeWindowKeyboard[0], pipeWindowKeyboard[1],
+                            pipeWatchdogWindow[0], pipeWatchdogWindow[1],
+                            pipeKeyboardDrone[0], pipeKeyboardDrone[1]);
+                    char *argsGenerator[maxMsgLength / 2] = {"./bin/loadGenerator", args, launchArgs};
+                    int n = 3;
+                    for (int j = 0; j < extraArgc && n < maxMsgLength / 2 - 1; j++) {
+                        argsGenerator[n++] = extraArgv[j];
+                    }
+                    argsGenerator[n] = NULL;
+                    summon(argsGenerator, 0, 0, 1);
+                }
+                // Window process
+                sprintf(args, "%d %d|%d %d", pipeWindowKeyboard[0], pipeWindowKeyboard[1],
+                        pipeWatchdogWindow[0], pipeWatchdogWindow[1]);
+                char *argsWindow[] = {"/usr/bin/konsole", "-e", "./bin/window", args, launchArgs, NULL};
+                summon(argsWindow, 0, 0, 1);
+                break;
+            case 2:
+                // KeyboardManager process, or the autopilot on the same pipes
+                sprintf(args, "%d %d|%d %d|%d %d", pipeWindowKeyboard[0], pipeWindowKeyboard[1],
+                        pipeKeyboardDrone[0], pipeKeyboardDrone[1],
+                        pipeWatchdogKeyboard[0], pipeWatchdogKeyboard[1]);
+                if (mission != NULL) {
+                    char *argsAutopilot[] = {"./bin/autopilot", args, launchArgs, mission, NULL};
+                    summon(argsAutopilot, 0, 0, 0);
+                }
+                char *argsKeyboard[] = {"./bin/keyboardManager", args, launchArgs, NULL};
+                summon(argsKeyboard, 0, 0, 0);
+                break;
+            case 3:
+                // DroneDynamics process
+                sprintf(args, "%d %d|%d %d", pipeKeyboardDrone[0], pipeKeyboardDrone[1],
+                        pipeWatchdogDrone[0], pipeWatchdogDrone[1]);
+                char *argsDrone[] = {"./bin/droneDynamics", args, launchArgs, NULL};
+                summon(argsDrone, 0, 0, 0);
+                break;
+            case 4:
+                // Watchdog process
+                sprintf(args, "%d %d|%d %d|%d %d|%d %d|%d", pipeWatchdogServer[0], pipeWatchdogServer[1],
+                        pipeWatchdogWindow[0], pipeWatchdogWindow[1],
+                        pipeWatchdogKeyboard[0], pipeWatchdogKeyboard[1],
+                        pipeWatchdogDrone[0], pipeWatchdogDrone[1], allPID[3]);
+                char *argsWatchdog[] = {"/usr/bin/konsole", "-e", "./bin/watchdog", args, launchArgs, NULL};
+                summon(argsWatchdog, 0, 0, 1);
+                break;
+        }
+    } else if (pid < 0) {
+        perror("fork failed");
+        exit(EXIT_FAILURE);
+    }
+
+    return pid;
+}
+
+int main(int argc, char *argv[]) {
+    // Command line options: -l replaces window with the synthetic load generator,
+    // everything after "--" is forwarded to it (e.g. ./bin/master -l -- -r 100000 -t 10);
+    // -s restarts a failed component instead of terminating the whole simulation;
+    // -r resumes the simulation from the last checkpoint; -R applies the real-time profile;
+    // -a steers the drone with the autopilot through the given mission file instead of the keyboard;
+    // -n splits the board into strips simulated by that many droneDynamics processes, -N adds a swarm;
+    // -w loads obstacles and targets from a file into the shared world (the mission file by default);
+    // -v runs the headless simulation on a virtual clock, as fast as the components can step it
+    int opt;
+    while ((opt = getopt(argc, argv, "lsrRva:n:N:w:")) != -1) {
+        switch (opt) {
+            case 'l':
+                loadGenerator = 1; break;
+            case 's':
+                supervise = 1; break;
+            case 'r':
+                restore = 1; break;
+            case 'R':
+                realtime = 1; break;
+            case 'v':
+                virtualTime = 1; break;
+            case 'a':
+                mission = optarg; break;
+            case 'n':
+                shards = atoi(optarg); break;
+            case 'N':
+                swarmSize = atoi(optarg); break;
+            case 'w':
+                worldFile = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-s] [-r] [-R] [-v] [-a mission] [-w world] [-n shards [-N swarm]] [-l [-- load generator options]]\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (worldFile == NULL) {
+        worldFile = mission;
+    }
+    if (shards < 1 || shards > maxShards || swarmSize < 0) {
+        fprintf(stderr, "shards must be between 1 and %d\n", maxShards);
+        exit(EXIT_FAILURE);
+    }
+    if (swarmSize > 0 && shards == 1) {
+        fprintf(stderr, "the swarm is simulated by the sharded drone dynamics, use -n 2 or more\n");
+        exit(EXIT_FAILURE);
+    }
+    if (virtualTime && (!loadGenerator || shards > 1)) {
+        fprintf(stderr, "the virtual clock needs the load generator (-l) and an unsharded board\n");
+        exit(EXIT_FAILURE);
+    }
+    if (swarmSize > shards * shardCapacity - 1) { // one place is kept for the keyboard drone
+        fprintf(stderr, "%d shards hold at most %d swarm drones\n", shards, shards * shardCapacity - 1);
+        exit(EXIT_FAILURE);
+    }
+    if (shards > 1 && shardCreate(shards, swarmSize, 1) == -1) {
+        perror("shard segment");
+        exit(EXIT_FAILURE);
+    }
+    // -r on a sharded board puts the checkpointed swarm back before the shards start
+    if (restore && shards > 1) {
+        struct ShardSegment *segment = shardAttach();
+        unsigned long long tick = segment != NULL ? checkpointRestoreSwarm(CHECKPOINT_PATH, segment) : 0;
+        if (tick > 0) {
+            printf("Restored the swarm of %d drones from the checkpoint of tick %llu\n", swarmSize, tick);
+        } else {
+            printf("No swarm of %d drones in %s, starting a new one\n", swarmSize, CHECKPOINT_PATH);
+        }
+        if (segment != NULL) {
+            munmap(segment, sizeof(struct ShardSegment));
+        }
+    }
+    if (realtime && shards > 1) {
+        int cores[numberOfProcesses] = rtCores;
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        if (cores[3] >= 0 && cores[3] + shards > online) {
+            fprintf(stderr, "warning: %d shards from core %d on %ld online CPUs, some shards share a core\n",
+                    shards, cores[3], online);
+        }
+    }
+    extraArgc = argc - optind;
+    extraArgv = argv + optind;
 
     // Check if pipes are created successfully
     if (pipe(pipeWindowKeyboard) == -1 || pipe(pipeKeyboardDrone) == -1) {
@@ -31,96 +232,165 @@ int main() {
         exit(EXIT_FAILURE);
     }
 
-    // Additional pipes for communication with the watchdog process
-    int pipeWatchdogServer[2];
-    int pipeWatchdogWindow[2];
-    int pipeWatchdogKeyboard[2];
-    int pipeWatchdogDrone[2];
-
-    // Check if additional pipes are created successfully
-    if (pipe(pipeWatchdogDrone) == -1 || pipe(pipeWatchdogKeyboard) == -1 || 
+    // Check if additional pipes for the watchdog are created successfully
+    if (pipe(pipeWatchdogDrone) == -1 || pipe(pipeWatchdogKeyboard) == -1 ||
         pipe(pipeWatchdogServer) == -1 || pipe(pipeWatchdogWindow) == -1) {
         perror("pipe creation failed");
         exit(EXIT_FAILURE);
     }
 
-    // Array to store PIDs of all processes
-    pid_t allPID[numberOfProcesses];
+    // The watchdog sends SIGTERM to master when it tears everything down in supervision mode
+    struct sigaction shutdownAction;
+    shutdownAction.sa_handler = handleShutdown;
+    shutdownAction.sa_flags = 0;
+    sigemptyset(&shutdownAction.sa_mask);
+    sigaction(SIGTERM, &shutdownAction, NULL);
+
     char *nameOfProcess[numberOfProcesses] = {"Server", "Window", "KeyboardManager", "DroneDynamics", "Watchdog"};
+    if (loadGenerator) {
+        nameOfProcess[1] = "LoadGenerator";
+    }
+    if (mission != NULL) {
+        nameOfProcess[2] = "Autopilot";
+    }
+
+    // The clock exists before its participants start; the driver waits until all of them have registered
+    struct VirtualClock *virtualClock = NULL;
+    pthread_t clockThread;
+    if (virtualTime) {
+        virtualClock = clockCreate();
+        if (virtualClock == NULL || pthread_create(&clockThread, NULL, clockDrive, virtualClock) != 0) {
+            perror("virtual clock");
+            exit(EXIT_FAILURE);
+        }
+    }
 
     // Loop to fork and launch each process
     for (int i = 0; i < numberOfProcesses; i++) {
-        pid_t pid = fork();
-        allPID[i] = pid;
-        char args[maxMsgLength];
-
-        if (pid == 0) { // Child process
-            switch (i) {
-                case 0:
-                    // Server process
-                    sprintf(args, "%d %d", pipeWatchdogServer[0], pipeWatchdogServer[1]);
-                    char *argsServer[] = {"./bin/server", args, NULL};
-                    summon(argsServer, 0, 0, 0);
-                    break;
-                case 1:
-                    // Window process
-                    sprintf(args, "%d %d|%d %d", pipeWindowKeyboard[0], pipeWindowKeyboard[1], 
-                            pipeWatchdogWindow[0], pipeWatchdogWindow[1]);
-                    char *argsWindow[] = {"/usr/bin/konsole", "-e", "./bin/window", args, NULL};
-                    summon(argsWindow, 0, 0, 1);
-                    break;
-                case 2:
-                    // KeyboardManager process
-                    sprintf(args, "%d %d|%d %d|%d %d", pipeWindowKeyboard[0], pipeWindowKeyboard[1], 
-                            pipeKeyboardDrone[0], pipeKeyboardDrone[1], 
-                            pipeWatchdogKeyboard[0], pipeWatchdogKeyboard[1]);
-                    char *argsKeyboard[] = {"./bin/keyboardManager", args, NULL};
-                    summon(argsKeyboard, 0, 0, 0);
-                    break;
-                case 3:
-                    // DroneDynamics process
-                    sprintf(args, "%d %d|%d %d", pipeKeyboardDrone[0], pipeKeyboardDrone[1], 
-                            pipeWatchdogDrone[0], pipeWatchdogDrone[1]);
-                    char *argsDrone[] = {"./bin/droneDynamics", args, NULL};
-                    summon(argsDrone, 0, 0, 0);
-                    break;
-                case 4:
-                    // Watchdog process
-                    sprintf(args, "%d %d|%d %d|%d %d|%d %d|%d", pipeWatchdogServer[0], pipeWatchdogServer[1], 
-                            pipeWatchdogWindow[0], pipeWatchdogWindow[1], 
-                            pipeWatchdogKeyboard[0], pipeWatchdogKeyboard[1], 
-                            pipeWatchdogDrone[0], pipeWatchdogDrone[1], allPID[3]);
-                    char *argsWatchdog[] = {"/usr/bin/konsole", "-e", "./bin/watchdog", args, NULL};
-                    summon(argsWatchdog, 0, 0, 1);
-                    break;
+        allPID[i] = launch(i, 0, 0);
+        printf("Launched %s, PID: %d\n", nameOfProcess[i], allPID[i]);
+        if (i == 3) {
+            for (int shard = 1; shard < shards; shard++) {
+                shardPID[shard] = launch(3, shard, 0);
+                printf("Launched DroneDynamics shard %d, PID: %d\n", shard, shardPID[shard]);
             }
-        } else if (pid < 0) {
-            perror("fork failed");
-            exit(EXIT_FAILURE);
-        } else {
-            // Parent process
-            printf("Launched %s, PID: %d\n", nameOfProcess[i], pid);
         }
     }
+    long long startedAt = monotonicNs();
+
+    // Restart bookkeeping for supervision mode
+    int restartCount[numberOfProcesses] = {0};
+    time_t firstRestart[numberOfProcesses] = {0};
 
     // Wait for any child process to terminate
-    int status;
-    pid_t terminatedPid = wait(&status);
-    if (terminatedPid == -1) {
-        perror("waitpid failed");
-        exit(EXIT_FAILURE);
+    pid_t terminatedPid;
+    while (1) {
+        int status;
+        terminatedPid = wait(&status);
+        if (terminatedPid == -1) {
+            if (errno == EINTR && !shutdownRequested) {
+                continue;
+            }
+            if (errno == EINTR) {
+                break;
+            }
+            perror("waitpid failed");
+            exit(EXIT_FAILURE);
+        }
+        long long detectedAt = monotonicNs();
+
+        int failed = -1, failedShard = 0;
+        for (int i = 0; i < numberOfProcesses; i++) {
+            if (allPID[i] == terminatedPid) {
+                failed = i;
+            }
+        }
+        for (int shard = 1; shard < shards; shard++) {
+            if (shardPID[shard] == terminatedPid) {
+                failed = 3;
+                failedShard = shard;
+            }
+        }
+
+        // A clean exit (the user pressed 'q') or a requested shutdown always ends the simulation
+        int cleanExit = WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+        if (!supervise || failed < 0 || cleanExit || shutdownRequested) {
+            break;
+        }
+
+        // Giving up on a component that keeps crashing
+        time_t now = time(NULL);
+        if (now - firstRestart[failed] > restartWindow) {
+            firstRestart[failed] = now;
+            restartCount[failed] = 0;
+        }
+        if (++restartCount[failed] > maxRestarts) {
+            printf("%s failed %d times in %d s, terminating\n", nameOfProcess[failed], restartCount[failed], restartWindow);
+            break;
+        }
+
+        pid_t restarted = launch(failed, failedShard, detectedAt);
+        if (failedShard > 0) {
+            shardPID[failedShard] = restarted;
+        } else {
+            allPID[failed] = restarted;
+        }
+        printf("Restarted %s%s, PID: %d (%s %d)\n", nameOfProcess[failed], failedShard > 0 ? " shard" : "", restarted,
+               WIFSIGNALED(status) ? "signal" : "exit status",
+               WIFSIGNALED(status) ? WTERMSIG(status) : WEXITSTATUS(status));
     }
 
     // Terminate all other processes if one process exits
     for (int i = 0; i < numberOfProcesses; i++) {
         if (allPID[i] != terminatedPid) {
-            // Kill process and check for errors
-            if (kill(allPID[i], SIGTERM) == -1) {
+            // Kill process and check for errors; in supervision mode some may already be gone
+            if (kill(allPID[i], SIGTERM) == -1 && !(supervise && errno == ESRCH)) {
                 perror("kill failed");
                 exit(EXIT_FAILURE);
             }
         }
     }
+    for (int shard = 1; shard < shards; shard++) {
+        if (shardPID[shard] != terminatedPid) {
+            kill(shardPID[shard], SIGTERM);
+        }
+    }
+
+    if (virtualClock != NULL) {
+        double seconds = (monotonicNs() - startedAt) / 1e9, simulated = clockNow(virtualClock) / 1e9;
+        printf("Virtual clock: %.1f s simulated in %.2f s (%.0fx real time), %lu turns\n", simulated, seconds,
+               seconds > 0 ? simulated / seconds : 0.0, atomic_load(&virtualClock->turns));
+        shm_unlink(CLOCK_SHM_PATH);
+    }
+
+    // Throughput of the sharded simulation over the whole run. The wall-clock rate is bounded by the fixed
+    // tick; the compute rate (updates per second actually spent updating) is what grows with the shards,
+    // since they compute in parallel
+    if (shards > 1) {
+        struct ShardSegment *segment = shardAttach();
+        if (segment != NULL) {
+            double seconds = (monotonicNs() - startedAt) / 1e9;
+            unsigned long total = 0;
+            double computeRate = 0;
+            for (int shard = 0; shard < shards; shard++) {
+                struct ShardRegion *region = &segment->regions[shard];
+                unsigned long updates = atomic_load(&region->updates);
+                double computeSeconds = atomic_load(&region->computeNs) / 1e9;
+                unsigned inFlight = 0;
+                for (int side = 0; side < 2; side++) {
+                    inFlight += atomic_load(&region->outbound[side].head) - atomic_load(&region->outbound[side].tail);
+                }
+                printf("Shard %d: %lu drone updates in %.3f s of compute (%.3g updates/s), %d drones at exit, %u in flight\n",
+                       shard, updates, computeSeconds, computeSeconds > 0 ? updates / computeSeconds : 0.0, region->count, inFlight);
+                total += updates;
+                computeRate += computeSeconds > 0 ? updates / computeSeconds : 0.0;
+            }
+            printf("%d shards: %lu drone updates in %.1f s (%.0f updates/s), %.3g updates/s of compute\n",
+                   shards, total, seconds, total / seconds, computeRate);
+            munmap(segment, sizeof(struct ShardSegment));
+        }
+        shm_unlink(SHARD_SHM_PATH);
+    }
 
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,502 @@
+#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <sched.h>
+#include <time.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include "../include/constant.h"
+#include "../include/droneModel.h"
+#include "../include/dstarLite.h"
+
+// Microbenchmarks of the physics kernels and of the IPC primitives the processes use.
+// Each benchmark runs a number of repetitions of a fixed batch and reports per-operation
+// statistics over the repetitions, one JSON object per line, so runs can be compared across commits.
+
+#define BENCH_SHM_PATH "/microbench_shm"
+#define BENCH_SEM_PATH "/microbench_sem"
+
+int repetitions = 21;
+const char *commit = "unknown";
+FILE *output = NULL;
+volatile double sink; // keeps the compiler from dropping benchmarked work
+
+double nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int compareDouble(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Summarising per-operation times (ns) of every repetition
+void report(const char *name, const char *unit, double *samples, int count, long batch) {
+    qsort(samples, count, sizeof(double), compareDouble);
+    double sum = 0, squares = 0;
+    for (int i = 0; i < count; i++) {
+        sum += samples[i];
+    }
+    double mean = sum / count;
+    for (int i = 0; i < count; i++) {
+        squares += (samples[i] - mean) * (samples[i] - mean);
+    }
+    double stddev = count > 1 ? sqrt(squares / (count - 1)) : 0;
+    double median = count % 2 ? samples[count / 2] : (samples[count / 2 - 1] + samples[count / 2]) / 2;
+    double p90 = samples[(int)((count - 1) * 0.9)];
+
+    const char *line = "{\"commit\":\"%s\",\"benchmark\":\"%s\",\"unit\":\"%s\",\"batch\":%ld,\"repetitions\":%d,"
+                       "\"median\":%.3f,\"mean\":%.3f,\"stddev\":%.3f,\"min\":%.3f,\"p90\":%.3f,\"max\":%.3f}\n";
+    printf(line, commit, name, unit, batch, count, median, mean, stddev, samples[0], p90, samples[count - 1]);
+    if (output != NULL) {
+        fprintf(output, line, commit, name, unit, batch, count, median, mean, stddev, samples[0], p90, samples[count - 1]);
+    }
+    fflush(stdout);
+}
+
+// ---------------------------------------------------------------- physics kernels
+
+void benchComputePosition(long batch) {
+    double samples[repetitions];
+    double x1 = 10, x2 = 9.5;
+    for (int r = -1; r < repetitions; r++) { // repetition -1 is the warm-up
+        double start = nowNs();
+        for (long i = 0; i < batch; i++) {
+            double x = computePositionDouble((i & 3) - 1, x1, x2);
+            x2 = x1;
+            x1 = x;
+        }
+        if (r >= 0) {
+            samples[r] = (nowNs() - start) / batch;
+        }
+    }
+    sink = x1;
+    report("computePosition", "ns/call", samples, repetitions, batch);
+}
+
+// updatePosition over a swarm stored like the shared segment, 6 values per drone
+void benchUpdatePosition(int drones, long updates) {
+    positionReal *state = malloc(6 * sizeof(positionReal) * drones);
+    if (state == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < 6 * drones; i++) {
+        state[i] = positionFromDouble(boardSize / 2);
+    }
+    int forces[4][2] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
+
+    long rounds = updates / drones > 0 ? updates / drones : 1;
+    double samples[repetitions];
+    for (int r = -1; r < repetitions; r++) {
+        double start = nowNs();
+        for (long round = 0; round < rounds; round++) {
+            for (int d = 0; d < drones; d++) {
+                updatePosition(&state[6 * d], forces[(round + d) & 3]);
+            }
+        }
+        if (r >= 0) {
+            samples[r] = (nowNs() - start) / (rounds * drones);
+        }
+    }
+    sink = positionToDouble(state[4]);
+    free(state);
+
+    char name[64];
+    snprintf(name, sizeof(name), "updatePosition/drones=%d", drones);
+    report(name, "ns/drone", samples, repetitions, rounds * drones);
+}
+
+// ---------------------------------------------------------------- path planning
+
+// Many drones planning at once on the autopilot's grid: every planner searches from its own goal towards
+// its own drone, which takes one step of its path per tick, and every tenth tick a cell next to the walls
+// flips for all of them. Reports the time of one tick of all planners together, to be held against
+// droneTickUs, after reporting the full search each planner starts with.
+void benchDStar(int plannerCount, long ticks) {
+    int size = boardSize * plannerResolution + 1;
+    static const double walls[3][4] = {{40, 0, 45, 60}, {55, 40, 100, 45}, {30, 65, 35, 100}}; // missions/demo.txt
+    struct DStarLite *planners = malloc(plannerCount * sizeof(struct DStarLite));
+    int *home = malloc(plannerCount * sizeof(int));
+    if (planners == NULL || home == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    srand(1);
+    double setupNs = 0;
+    for (int p = 0; p < plannerCount; p++) {
+        if (dstarInit(&planners[p], size, size) == -1) {
+            perror("planner allocation");
+            exit(EXIT_FAILURE);
+        }
+        for (int w = 0; w < 3; w++) {
+            for (int y = walls[w][1] * plannerResolution; y <= walls[w][3] * plannerResolution; y++) {
+                for (int x = walls[w][0] * plannerResolution; x <= walls[w][2] * plannerResolution; x++) {
+                    planners[p].blocked[y * size + x] = 1;
+                }
+            }
+        }
+        int goal, start;
+        do {
+            goal = rand() % (size * size);
+            start = rand() % (size * size);
+        } while (planners[p].blocked[goal] || planners[p].blocked[start] || dstarHeuristic(&planners[p], goal, start) < size / 2);
+        home[p] = start;
+        double begin = nowNs();
+        dstarSetGoal(&planners[p], start, goal);
+        dstarComputePath(&planners[p]);
+        setupNs += nowNs() - begin;
+    }
+    double setupSamples[1] = {setupNs / plannerCount / 1e3};
+    char name[64];
+    snprintf(name, sizeof(name), "dstarFullSearch/planners=%d", plannerCount);
+    report(name, "us/planner", setupSamples, 1, plannerCount);
+
+    int flip = (int)(45 * plannerResolution) + 1 + (int)(30 * plannerResolution) * size; // beside the first wall
+    long tick = 0;
+    unsigned long expanded = 0;
+    double samples[repetitions];
+    for (int r = -1; r < repetitions; r++) {
+        double start = nowNs();
+        for (long t = 0; t < ticks; t++, tick++) {
+            for (int p = 0; p < plannerCount; p++) {
+                struct DStarLite *planner = &planners[p];
+                if (tick % 10 == 0) {
+                    dstarSetBlocked(planner, flip, !planner->blocked[flip]);
+                }
+                int next = planner->start == planner->goal ? home[p] : dstarNextStep(planner);
+                dstarMoveStart(planner, next >= 0 ? next : home[p]);
+                dstarComputePath(planner);
+                expanded += planner->expanded;
+            }
+        }
+        if (r >= 0) {
+            samples[r] = (nowNs() - start) / ticks / 1e3;
+        }
+    }
+    sink = expanded;
+    for (int p = 0; p < plannerCount; p++) {
+        dstarFree(&planners[p]);
+    }
+    free(planners);
+    free(home);
+
+    snprintf(name, sizeof(name), "dstarTick/planners=%d", plannerCount);
+    report(name, "us/tick", samples, repetitions, ticks * plannerCount);
+}
+
+// ---------------------------------------------------------------- shared memory under the semaphore
+
+// Same sequence as server.c, window.c and droneDynamics.c: sem_wait, memcpy of the position, sem_post.
+// With contended=1 a second process keeps publishing into the segment under the same semaphore.
+void benchSharedCopy(long batch, int contended) {
+    positionReal position[6];
+    size_t size = sizeof(position);
+
+    sem_unlink(BENCH_SEM_PATH);
+    shm_unlink(BENCH_SHM_PATH);
+    sem_t *semaphore = sem_open(BENCH_SEM_PATH, O_CREAT, S_IRUSR | S_IWUSR, 1);
+    int fd = shm_open(BENCH_SHM_PATH, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+    if (semaphore == SEM_FAILED || fd < 0 || ftruncate(fd, size) == -1) {
+        perror("shared memory setup");
+        exit(EXIT_FAILURE);
+    }
+    void *shared = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (shared == MAP_FAILED) {
+        perror("mmap");
+        exit(EXIT_FAILURE);
+    }
+    memset(position, 0, size);
+
+    pid_t writer = -1;
+    if (contended) {
+        writer = fork();
+        if (writer == 0) {
+            positionReal local[6] = {0};
+            while (1) {
+                local[4] += 1;
+                sem_wait(semaphore);
+                memcpy(shared, local, size);
+                sem_post(semaphore);
+            }
+        }
+    }
+
+    double samples[repetitions];
+    for (int r = -1; r < repetitions; r++) {
+        double start = nowNs();
+        for (long i = 0; i < batch; i++) {
+            sem_wait(semaphore);
+            memcpy(position, shared, size);
+            sem_post(semaphore);
+        }
+        if (r >= 0) {
+            samples[r] = (nowNs() - start) / batch;
+        }
+    }
+    sink = positionToDouble(position[4]);
+
+    if (writer > 0) {
+        kill(writer, SIGKILL);
+        waitpid(writer, NULL, 0);
+    }
+    munmap(shared, size);
+    close(fd);
+    sem_close(semaphore);
+    sem_unlink(BENCH_SEM_PATH);
+    shm_unlink(BENCH_SHM_PATH);
+
+    report(contended ? "shmCopy/contended" : "shmCopy/uncontended", "ns/copy", samples, repetitions, batch);
+}
+
+// ---------------------------------------------------------------- message latency
+
+// One-way latency is half of a ping-pong round trip between two processes, for the two message
+// types on the pipelines: a key (int, window -> keyboardManager) and a force direction (int[2],
+// keyboardManager -> droneDynamics)
+enum transport { TRANSPORT_PIPE, TRANSPORT_EVENTFD, TRANSPORT_SOCKET, TRANSPORT_RING };
+static const char *transportNames[] = {"pipe", "eventfd", "unixSocket", "sharedRing"};
+
+#define RING_SLOTS 64
+
+// Spinning waits yield after a while so the benchmark still completes on a single CPU
+#define SPINS_BEFORE_YIELD 1000
+
+// Single-producer single-consumer ring in a shared mapping, one per direction
+struct Ring {
+    _Alignas(64) atomic_ulong head;
+    _Alignas(64) atomic_ulong tail;
+    _Alignas(64) int slots[RING_SLOTS][2];
+};
+
+void ringSend(struct Ring *ring, int *message, size_t size) {
+    unsigned long head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    for (int spins = 0; head - atomic_load_explicit(&ring->tail, memory_order_acquire) >= RING_SLOTS; spins++) {
+        if (spins > SPINS_BEFORE_YIELD) {
+            sched_yield();
+        }
+    }
+    memcpy(ring->slots[head % RING_SLOTS], message, size);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+void ringReceive(struct Ring *ring, int *message, size_t size) {
+    unsigned long tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    for (int spins = 0; atomic_load_explicit(&ring->head, memory_order_acquire) == tail; spins++) {
+        if (spins > SPINS_BEFORE_YIELD) {
+            sched_yield();
+        }
+    }
+    memcpy(message, ring->slots[tail % RING_SLOTS], size);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+struct Channel {
+    enum transport kind;
+    int fds[2];          // pipe / eventfd / socket descriptors of this direction
+    struct Ring *ring;
+};
+
+void channelOpen(struct Channel *channel, enum transport kind, struct Ring *ring) {
+    channel->kind = kind;
+    channel->ring = ring;
+    int result = 0;
+    switch (kind) {
+        case TRANSPORT_PIPE:
+            result = pipe(channel->fds);
+            break;
+        case TRANSPORT_EVENTFD:
+            channel->fds[0] = channel->fds[1] = eventfd(0, 0);
+            result = channel->fds[0];
+            break;
+        case TRANSPORT_SOCKET:
+            result = socketpair(AF_UNIX, SOCK_SEQPACKET, 0, channel->fds);
+            break;
+        case TRANSPORT_RING:
+            atomic_init(&ring->head, 0);
+            atomic_init(&ring->tail, 0);
+            break;
+    }
+    if (result < 0) {
+        perror(transportNames[kind]);
+        exit(EXIT_FAILURE);
+    }
+}
+
+void channelClose(struct Channel *channel) {
+    if (channel->kind == TRANSPORT_RING) {
+        return;
+    }
+    close(channel->fds[0]);
+    if (channel->fds[1] != channel->fds[0]) {
+        close(channel->fds[1]);
+    }
+}
+
+void channelSend(struct Channel *channel, int *message, size_t size) {
+    if (channel->kind == TRANSPORT_RING) {
+        ringSend(channel->ring, message, size);
+        return;
+    }
+    if (channel->kind == TRANSPORT_EVENTFD) {
+        // An eventfd carries a non-zero 64-bit counter, the message is packed into it
+        uint64_t value = 1;
+        memcpy(&value, message, size < sizeof(value) ? size : sizeof(value));
+        value |= 1ULL << 63;
+        write(channel->fds[1], &value, sizeof(value));
+        return;
+    }
+    write(channel->fds[1], message, size);
+}
+
+void channelReceive(struct Channel *channel, int *message, size_t size) {
+    if (channel->kind == TRANSPORT_RING) {
+        ringReceive(channel->ring, message, size);
+        return;
+    }
+    if (channel->kind == TRANSPORT_EVENTFD) {
+        uint64_t value;
+        read(channel->fds[0], &value, sizeof(value));
+        value &= ~(1ULL << 63);
+        memcpy(message, &value, size < sizeof(value) ? size : sizeof(value));
+        return;
+    }
+    size_t received = 0;
+    while (received < size) {
+        ssize_t n = read(channel->fds[0], (char *)message + received, size - received);
+        if (n <= 0) {
+            perror("read");
+            exit(EXIT_FAILURE);
+        }
+        received += n;
+    }
+}
+
+void benchLatency(enum transport kind, size_t size, long batch) {
+    struct Ring *rings = mmap(NULL, 2 * sizeof(struct Ring), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (rings == MAP_FAILED) {
+        perror("mmap");
+        exit(EXIT_FAILURE);
+    }
+    struct Channel ping, pong;
+    channelOpen(&ping, kind, &rings[0]);
+    channelOpen(&pong, kind, &rings[1]);
+    long total = (repetitions + 1) * batch;
+
+    pid_t echo = fork();
+    if (echo == 0) {
+        int message[2];
+        for (long i = 0; i < total; i++) {
+            channelReceive(&ping, message, size);
+            channelSend(&pong, message, size);
+        }
+        _exit(0);
+    }
+
+    double samples[repetitions];
+    int message[2] = {'f', 0};
+    for (int r = -1; r < repetitions; r++) {
+        double start = nowNs();
+        for (long i = 0; i < batch; i++) {
+            message[1] = i;
+            channelSend(&ping, message, size);
+            channelReceive(&pong, message, size);
+        }
+        if (r >= 0) {
+            samples[r] = (nowNs() - start) / batch / 2;
+        }
+    }
+    waitpid(echo, NULL, 0);
+    channelClose(&ping);
+    channelClose(&pong);
+    munmap(rings, 2 * sizeof(struct Ring));
+
+    char name[64];
+    snprintf(name, sizeof(name), "latency/%s/%s", transportNames[kind], size == sizeof(int) ? "key" : "forceDirection");
+    report(name, "ns/message", samples, repetitions, batch);
+}
+
+int main(int argc, char *argv[]) {
+    const char *outputPath = NULL;
+    int cpu = -1;
+    double scale = 1.0;
+    int opt;
+    while ((opt = getopt(argc, argv, "r:o:c:p:s:")) != -1) {
+        switch (opt) {
+            case 'r':
+                repetitions = atoi(optarg); break;
+            case 'o':
+                outputPath = optarg; break;
+            case 'c':
+                commit = optarg; break;
+            case 'p':
+                cpu = atoi(optarg); break;
+            case 's':
+                scale = atof(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-r repetitions] [-o output.jsonl] [-c commit] [-p cpu] [-s batch scale]\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (repetitions < 1 || scale <= 0) {
+        fprintf(stderr, "repetitions and batch scale must be positive\n");
+        exit(EXIT_FAILURE);
+    }
+    if (outputPath != NULL) {
+        output = fopen(outputPath, "a");
+        if (output == NULL) {
+            perror("Error opening output file");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Pinning the measuring process removes migrations from the numbers
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) == -1) {
+            perror("sched_setaffinity");
+        }
+    }
+
+    benchComputePosition((long)(1000000 * scale));
+    int swarms[] = {1, 100, 10000};
+    for (int i = 0; i < 3; i++) {
+        benchUpdatePosition(swarms[i], (long)(1000000 * scale));
+    }
+
+    int planners[] = {1, 8, 64};
+    for (int i = 0; i < 3; i++) {
+        benchDStar(planners[i], (long)(50 * scale) > 0 ? (long)(50 * scale) : 1);
+    }
+
+    benchSharedCopy((long)(200000 * scale), 0);
+    benchSharedCopy((long)(20000 * scale), 1);
+
+    for (int kind = TRANSPORT_PIPE; kind <= TRANSPORT_RING; kind++) {
+        benchLatency(kind, sizeof(int), (long)(5000 * scale));
+        benchLatency(kind, 2 * sizeof(int), (long)(5000 * scale));
+    }
+
+    if (output != NULL) {
+        fclose(output);
+    }
+    return 0;
+}
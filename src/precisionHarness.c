@@ -0,0 +1,150 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#include <signal.h>
+#include "../include/constant.h"
+#include "../include/droneModel.h"
+
+// Runs the same command stream through the double, float and fixed-point integrators and reports
+// how far the cheaper representations drift from double and how many drone ticks per second each sustains
+
+double nowSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Command stream shared by every variant: the force direction in effect at each tick, a key every keyInterval ticks
+int *buildCommands(int ticks, int keyInterval, unsigned int seed) {
+    int *commands = malloc(2 * sizeof(int) * ticks);
+    if (commands == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    int forceDirection[2] = {0, 0};
+    srand(seed);
+    for (int t = 0; t < ticks; t++) {
+        if (t % keyInterval == 0) {
+            applyMovementKey(rand() % movementKeyCount, forceDirection);
+        }
+        commands[2 * t] = forceDirection[0];
+        commands[2 * t + 1] = forceDirection[1];
+    }
+    return commands;
+}
+
+// Each drone replays the stream from its own offset
+int *commandAt(int *commands, int ticks, int tick, int drone) {
+    return &commands[2 * ((tick + drone * 7919) % ticks)];
+}
+
+void *allocState(int drones, size_t size) {
+    void *state = malloc(6 * size * drones);
+    if (state == NULL) {
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    return state;
+}
+
+int main(int argc, char *argv[]) {
+    int ticks = 100000, drones = 100, keyInterval = 5;
+    unsigned int seed = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "t:n:k:s:")) != -1) {
+        switch (opt) {
+            case 't':
+                ticks = atoi(optarg); break;
+            case 'n':
+                drones = atoi(optarg); break;
+            case 'k':
+                keyInterval = atoi(optarg); break;
+            case 's':
+                seed = (unsigned int)strtoul(optarg, NULL, 10); break;
+            default:
+                fprintf(stderr, "usage: %s [-t ticks] [-n drones] [-k ticks between keys] [-s seed]\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (ticks <= 0 || drones <= 0 || keyInterval <= 0) {
+        fprintf(stderr, "ticks, drones and key interval must be positive\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int *commands = buildCommands(ticks, keyInterval, seed);
+    double *stateDouble = allocState(drones, sizeof(double));
+    float *stateFloat = allocState(drones, sizeof(float));
+    fixed_t *stateFixed = allocState(drones, sizeof(fixed_t));
+
+    // Accuracy pass: all variants in lockstep, divergence measured against double after every tick
+    for (int d = 0; d < drones; d++) {
+        for (int i = 0; i < 6; i++) {
+            stateDouble[6 * d + i] = boardSize / 2;
+            stateFloat[6 * d + i] = boardSize / 2;
+            stateFixed[6 * d + i] = toFixed(boardSize / 2);
+        }
+    }
+    double maxErrorFloat = 0, maxErrorFixed = 0, sumErrorFloat = 0, sumErrorFixed = 0;
+    for (int t = 0; t < ticks; t++) {
+        for (int d = 0; d < drones; d++) {
+            int *forceDirection = commandAt(commands, ticks, t, d);
+            updatePositionDouble(&stateDouble[6 * d], forceDirection);
+            updatePositionFloat(&stateFloat[6 * d], forceDirection);
+            updatePositionFixed(&stateFixed[6 * d], forceDirection);
+
+            double x = stateDouble[6 * d + 4], y = stateDouble[6 * d + 5];
+            double errorFloat = hypot(stateFloat[6 * d + 4] - x, stateFloat[6 * d + 5] - y);
+            double errorFixed = hypot(fromFixed(stateFixed[6 * d + 4]) - x, fromFixed(stateFixed[6 * d + 5]) - y);
+            maxErrorFloat = fmax(maxErrorFloat, errorFloat);
+            maxErrorFixed = fmax(maxErrorFixed, errorFixed);
+            sumErrorFloat += errorFloat;
+            sumErrorFixed += errorFixed;
+        }
+    }
+
+    // Throughput pass: each variant on its own
+    double start, rateDouble, rateFloat, rateFixed;
+    double total = (double)ticks * drones;
+
+    start = nowSeconds();
+    for (int t = 0; t < ticks; t++) {
+        for (int d = 0; d < drones; d++) {
+            updatePositionDouble(&stateDouble[6 * d], commandAt(commands, ticks, t, d));
+        }
+    }
+    rateDouble = total / (nowSeconds() - start);
+
+    start = nowSeconds();
+    for (int t = 0; t < ticks; t++) {
+        for (int d = 0; d < drones; d++) {
+            updatePositionFloat(&stateFloat[6 * d], commandAt(commands, ticks, t, d));
+        }
+    }
+    rateFloat = total / (nowSeconds() - start);
+
+    start = nowSeconds();
+    for (int t = 0; t < ticks; t++) {
+        for (int d = 0; d < drones; d++) {
+            updatePositionFixed(&stateFixed[6 * d], commandAt(commands, ticks, t, d));
+        }
+    }
+    rateFixed = total / (nowSeconds() - start);
+
+    printf("%d ticks x %d drones, a key every %d ticks, seed %u\n", ticks, drones, keyInterval, seed);
+    printf("%-8s %12s %16s %16s %18s\n", "variant", "state bytes", "max divergence", "mean divergence", "drone ticks/s");
+    printf("%-8s %12zu %16.6g %16.6g %18.0f\n", "double", 6 * sizeof(double), 0.0, 0.0, rateDouble);
+    printf("%-8s %12zu %16.6g %16.6g %18.0f\n", "float", 6 * sizeof(float), maxErrorFloat, sumErrorFloat / total, rateFloat);
+    printf("%-8s %12zu %16.6g %16.6g %18.0f\n", "fixed", 6 * sizeof(fixed_t), maxErrorFixed, sumErrorFixed / total, rateFixed);
+
+    free(commands);
+    free(stateDouble);
+    free(stateFloat);
+    free(stateFixed);
+
+    return 0;
+}
@@ -1,4 +1,5 @@
 #define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
 
 #include <stdio.h>
 #include <string.h>
@@ -12,6 +13,11 @@
 #include <sys/mman.h>
 #include <signal.h>
 #include "../include/constant.h"
+#include "../include/supervision.h"
+#include "../include/droneModel.h"
+#include "../include/sharedState.h"
+#include "../include/world.h"
+#include "../include/checkpoint.h"
 
 int main(int argc, char *argv[]) {
     // Signal handling for watchdog
@@ -35,11 +41,14 @@ int main(int argc, char *argv[]) {
     printf("%d\n", serverPID);
     close(pipeWatchdogServer[1]); // Closing unnecessary pipes
 
+    struct LaunchOptions launchOptions;
+    parseLaunchOptions(argc, argv, &launchOptions);
+
     // LOG FILE SETUP
     FILE *logFile;
     char logFilePath[100];
     snprintf(logFilePath, sizeof(logFilePath), "log/ServerLog.txt");
-    logFile = fopen(logFilePath, "w"); // "a" mode appends to the file
+    logFile = fopen(logFilePath, launchOptions.restartedAt ? "a" : "w"); // "a" mode appends to the file
 
     if (logFile == NULL) {
         perror("Error opening log file");
@@ -47,7 +56,7 @@ int main(int argc, char *argv[]) {
     }
 
     // SHARED MEMORY AND SEMAPHORE SETUP
-    double position[6];
+    positionReal position[6];
     int sharedSegSize = sizeof(position);
 
     sem_t *semaphoreID = sem_open(SEM_PATH, O_CREAT, S_IRUSR | S_IWUSR, 1);
@@ -56,7 +65,10 @@ int main(int argc, char *argv[]) {
         fclose(logFile);
         exit(EXIT_FAILURE);
     }
-    sem_init(semaphoreID, 1, 0);
+    // A restarted server reattaches to the semaphore the other processes are already using
+    if (!launchOptions.restartedAt) {
+        sem_init(semaphoreID, 1, 0);
+    }
 
     int shmFD = shm_open(SHM_PATH, O_CREAT | O_RDWR, S_IRWXU | S_IRWXG);
     if (shmFD < 0) {
@@ -66,7 +78,7 @@ int main(int argc, char *argv[]) {
         sem_unlink(SEM_PATH);
         exit(EXIT_FAILURE);
     }
-    if (ftruncate(shmFD, sharedSegSize) == -1) {
+    if (ftruncate(shmFD, SHM_SIZE) == -1) {
         perror("ftruncate");
         fclose(logFile);
         sem_close(semaphoreID);
@@ -74,7 +86,7 @@ int main(int argc, char *argv[]) {
         shm_unlink(SHM_PATH);
         exit(EXIT_FAILURE);
     }
-    void *shmPointer = mmap(NULL, sharedSegSize, PROT_READ | PROT_WRITE, MAP_SHARED, shmFD, 0);
+    void *shmPointer = mmap(NULL, SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, shmFD, 0);
     if (shmPointer == MAP_FAILED) {
         perror("mmap");
         fclose(logFile);
@@ -83,9 +95,72 @@ int main(int argc, char *argv[]) {
         shm_unlink(SHM_PATH);
         exit(EXIT_FAILURE);
     }
-    sem_post(semaphoreID);
+    // A fresh run starts from the centre of the board even when no window publishes it (load generator),
+    // written before the semaphore is released so that no component reads a previous run's position
+    if (!launchOptions.restartedAt && !launchOptions.restore) {
+        for (int i = 0; i < 6; i++) {
+            position[i] = positionFromDouble(boardSize / 2);
+        }
+        memcpy(shmPointer, position, sharedSegSize);
+    }
+    if (!launchOptions.restartedAt) {
+        sem_post(semaphoreID);
+    }
+    logRecovery(logFile, "Server", &launchOptions);
+
+    // WORLD SETUP: OBSTACLES AND TARGETS IN A SHARED ARENA, SERVER IS ITS ONLY WRITER
+    const char *worldPath = argc > 3 ? argv[3] : NULL;
+    struct ArenaHeader *arena = launchOptions.restartedAt ? arenaAttach(WORLD_SHM_PATH, 1) : NULL;
+    struct WorldList *world = arena != NULL ? worldList(arena) : NULL;
+    if (world == NULL) {
+        arena = arenaCreate(WORLD_SHM_PATH, worldArenaSize);
+        world = arena != NULL ? worldCreate(arena) : NULL;
+    }
+    if (world == NULL) {
+        perror("world arena");
+        exit(EXIT_FAILURE);
+    }
+    worldRecover(world);
+    struct stat worldLoaded;
+    memset(&worldLoaded, 0, sizeof(worldLoaded));
+    // -r puts back the world of the checkpoint; the world file is only read again once it changes
+    if (launchOptions.restore && !launchOptions.restartedAt) {
+        static struct WorldItem restored[worldMaxItems];
+        int items = checkpointRestoreWorld(CHECKPOINT_PATH, restored);
+        if (items >= 0) {
+            worldReplace(arena, world, restored, items);
+            if (worldPath != NULL) {
+                stat(worldPath, &worldLoaded);
+            }
+            fprintf(logFile, "World restored from %s: %d items\n", CHECKPOINT_PATH, items);
+            fflush(logFile);
+        }
+    }
+
+    struct SharedState *sharedState = shmPointer;
+    unsigned generation = stateGeneration(sharedState);
+    long long lastLog = 0;
 
     while (1) {
+        // RELOAD THE WORLD WHEN ITS FILE CHANGES (NANOSECOND TIMESTAMP, SIZE AND INODE)
+        struct stat worldStat;
+        if (worldPath != NULL && stat(worldPath, &worldStat) == 0 &&
+            (worldStat.st_mtim.tv_sec != worldLoaded.st_mtim.tv_sec || worldStat.st_mtim.tv_nsec != worldLoaded.st_mtim.tv_nsec ||
+             worldStat.st_size != worldLoaded.st_size || worldStat.st_ino != worldLoaded.st_ino)) {
+            worldLoaded = worldStat;
+            int items = worldLoad(arena, world, worldPath, logFile);
+            fprintf(logFile, "World %s loaded: %d items, %u arena blocks in use\n", worldPath, items, atomic_load(&arena->liveBlocks));
+            fflush(logFile);
+        }
+
+        // WAIT FOR A NEW STATE, AT MOST ONE LOG LINE PER serverLogIntervalUs
+        stateRateLimit(&lastLog, serverLogIntervalUs);
+        unsigned seen = generation;
+        generation = stateWait(sharedState, seen, stateWaitTimeoutUs);
+        if (generation == seen) {
+            continue;
+        }
+
         // COPY POSITION OF THE DRONE FROM SHARED MEMORY
         sem_wait(semaphoreID);
         memcpy(position, shmPointer, sharedSegSize);
@@ -93,16 +168,17 @@ int main(int argc, char *argv[]) {
 
         // Write to the log file
         fprintf(logFile, "Initial Position: %.2f, %.2f | Previous Position: %.2f, %.2f | Current Position: %.2f, %.2f]\n",
-                position[0], position[1], position[2], position[3], position[4], position[5]);
+                positionToDouble(position[0]), positionToDouble(position[1]), positionToDouble(position[2]),
+                positionToDouble(position[3]), positionToDouble(position[4]), positionToDouble(position[5]));
         fflush(logFile); // Ensure the data is written to the file immediately
-        sleep(1);
     }
 
     // CLEANUP
     shm_unlink(SHM_PATH);
+    shm_unlink(WORLD_SHM_PATH);
     sem_close(semaphoreID);
     sem_unlink(SEM_PATH);
-    munmap(shmPointer, sharedSegSize);
+    munmap(shmPointer, SHM_SIZE);
 
     // Close the log file
     fclose(logFile);
@@ -0,0 +1,313 @@
+#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <signal.h>
+#include "../include/constant.h"
+#include "../include/droneModel.h"
+
+// Headless Monte Carlo sweep of the drone model over M, K and T. Every simulation runs the
+// droneDynamics integrator (with the constants as runtime values) against its own command
+// stream from the board centre; simulations are spread over worker threads and the per-run
+// results are written as one contiguous column per metric.
+//
+// Output file layout (native endianness):
+//   struct SweepHeader, columnCount x struct SweepColumn, then each column as rows values of
+//   8 bytes at its offset. In numpy: np.fromfile(path, dtype, count=rows, offset=column.offset)
+
+#define SWEEP_MAGIC "DSWEEP01"
+#define workChunk 64 // simulations claimed by a worker at a time
+
+struct SweepHeader {
+    char magic[8];
+    uint32_t columnCount;
+    uint32_t reserved;
+    uint64_t rows;
+};
+
+struct SweepColumn {
+    char name[24];
+    char type[8];    // "f64" or "u64"
+    uint64_t offset; // from the start of the file
+};
+
+enum { colMass, colStiffness, colStep, colSeed, colSteps, colFinalX, colFinalY, colMeanSpeed, colMaxSpeed,
+       colPathLength, colWallSteps, columnCount };
+
+static const char *columnNames[columnCount] = {"mass", "stiffness", "step", "seed", "steps", "finalX", "finalY",
+                                               "meanSpeed", "maxSpeed", "pathLength", "wallSteps"};
+static const char *columnTypes[columnCount] = {"f64", "f64", "f64", "u64", "u64", "f64", "f64", "f64", "f64",
+                                               "f64", "u64"};
+
+// Columns are 8-byte slots: doubles or uint64_t depending on columnTypes
+union SweepValue {
+    double real;
+    uint64_t count;
+};
+
+struct Range {
+    double low, high;
+};
+
+struct Sweep {
+    long simulations;
+    int grid;                 // points per parameter in grid mode, 0 for random sampling
+    struct Range ranges[3];   // M, K, T
+    double duration;          // simulated seconds per run
+    double commandPeriod;     // simulated seconds between commands
+    int maxForce;
+    int randomForces;         // 1: uniform force vectors, 0: keyboard-like key presses
+    uint64_t seed;
+    union SweepValue *columns[columnCount];
+    atomic_long next;
+};
+
+// splitmix64: independent, reproducible streams whatever the thread count
+uint64_t nextRandom(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+double uniform(uint64_t *state) {
+    return (nextRandom(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+double sample(struct Range range, int gridIndex, int grid, uint64_t *state) {
+    if (grid > 1) {
+        return range.low + (range.high - range.low) * gridIndex / (grid - 1);
+    }
+    return grid == 1 ? range.low : range.low + (range.high - range.low) * uniform(state);
+}
+
+// Next command of the stream: the same keys keyboardManager understands, or a uniform force vector
+void nextCommand(struct Sweep *sweep, uint64_t *state, int *force) {
+    if (sweep->randomForces) {
+        force[0] = (int)(nextRandom(state) % (2 * sweep->maxForce + 1)) - sweep->maxForce;
+        force[1] = (int)(nextRandom(state) % (2 * sweep->maxForce + 1)) - sweep->maxForce;
+        return;
+    }
+    applyMovementKey(nextRandom(state) % movementKeyCount, force);
+    for (int axis = 0; axis < 2; axis++) {
+        force[axis] = force[axis] > sweep->maxForce ? sweep->maxForce : (force[axis] < -sweep->maxForce ? -sweep->maxForce : force[axis]);
+    }
+}
+
+void simulate(struct Sweep *sweep, long run) {
+    uint64_t state = sweep->seed ^ ((uint64_t)run * 0xD1B54A32D192ED03ULL);
+    uint64_t runSeed = state;
+
+    // Grid mode walks the M x K x T lattice, one command stream per lattice point and repetition
+    int points = sweep->grid > 0 ? sweep->grid : 1;
+    long lattice = run % ((long)points * points * points);
+    struct ModelParams params = {
+        sample(sweep->ranges[0], lattice % points, sweep->grid, &state),
+        sample(sweep->ranges[1], lattice / points % points, sweep->grid, &state),
+        sample(sweep->ranges[2], lattice / points / points, sweep->grid, &state)};
+    double damping = modelDamping(&params);
+
+    uint64_t steps = (uint64_t)ceil(sweep->duration / params.step);
+    uint64_t commandSteps = sweep->commandPeriod > params.step ? (uint64_t)(sweep->commandPeriod / params.step) : 1;
+    double x[2] = {boardSize / 2.0, boardSize / 2.0}, previous[2] = {x[0], x[1]};
+    int force[2] = {0, 0};
+    double speedSum = 0, maxSpeed = 0, pathLength = 0;
+    uint64_t wallSteps = 0;
+
+    for (uint64_t step = 0; step < steps; step++) {
+        if (step % commandSteps == 0) {
+            nextCommand(sweep, &state, force);
+        }
+        int wall = 0;
+        double moved[2];
+        for (int axis = 0; axis < 2; axis++) {
+            double next = computePositionParams(&params, damping, force[axis], x[axis], previous[axis]);
+            if (next < 0 || next > boardSize) { // same boundary conditions as updatePosition
+                next = fmax(0, fmin(next, boardSize));
+                wall = 1;
+            }
+            moved[axis] = next - x[axis];
+            previous[axis] = x[axis];
+            x[axis] = next;
+        }
+        double distance = hypot(moved[0], moved[1]);
+        pathLength += distance;
+        speedSum += distance;
+        maxSpeed = fmax(maxSpeed, distance / params.step);
+        wallSteps += wall;
+    }
+
+    union SweepValue **c = sweep->columns;
+    c[colMass][run].real = params.mass;
+    c[colStiffness][run].real = params.stiffness;
+    c[colStep][run].real = params.step;
+    c[colSeed][run].count = runSeed;
+    c[colSteps][run].count = steps;
+    c[colFinalX][run].real = x[0];
+    c[colFinalY][run].real = x[1];
+    c[colMeanSpeed][run].real = steps ? speedSum / (steps * params.step) : 0;
+    c[colMaxSpeed][run].real = maxSpeed;
+    c[colPathLength][run].real = pathLength;
+    c[colWallSteps][run].count = wallSteps;
+}
+
+void *worker(void *arg) {
+    struct Sweep *sweep = arg;
+    long done = 0;
+    while (1) {
+        long first = atomic_fetch_add(&sweep->next, workChunk);
+        if (first >= sweep->simulations) {
+            break;
+        }
+        long last = first + workChunk < sweep->simulations ? first + workChunk : sweep->simulations;
+        for (long run = first; run < last; run++) {
+            simulate(sweep, run);
+        }
+        done += last - first;
+    }
+    return (void *)done;
+}
+
+int writeColumns(const char *path, struct Sweep *sweep) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        return -1;
+    }
+    struct SweepHeader header = {SWEEP_MAGIC, columnCount, 0, (uint64_t)sweep->simulations};
+    fwrite(&header, sizeof(header), 1, file);
+
+    uint64_t offset = sizeof(header) + columnCount * sizeof(struct SweepColumn);
+    for (int i = 0; i < columnCount; i++) {
+        struct SweepColumn column = {{0}, {0}, offset};
+        strncpy(column.name, columnNames[i], sizeof(column.name) - 1);
+        strncpy(column.type, columnTypes[i], sizeof(column.type) - 1);
+        fwrite(&column, sizeof(column), 1, file);
+        offset += sweep->simulations * sizeof(union SweepValue);
+    }
+    for (int i = 0; i < columnCount; i++) {
+        fwrite(sweep->columns[i], sizeof(union SweepValue), sweep->simulations, file);
+    }
+    int failed = ferror(file);
+    return fclose(file) == 0 && !failed ? 0 : -1;
+}
+
+int parseRange(const char *text, struct Range *range) {
+    if (sscanf(text, "%lf:%lf", &range->low, &range->high) == 2) {
+        return range->low > 0 && range->high >= range->low;
+    }
+    if (sscanf(text, "%lf", &range->low) == 1) {
+        range->high = range->low;
+        return range->low > 0;
+    }
+    return 0;
+}
+
+double nowSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+    struct Sweep sweep = {
+        .simulations = 1000,
+        .grid = 0,
+        .ranges = {{M * 0.5, M * 2}, {K * 0.5, K * 2}, {T * 0.2, T}},
+        .duration = 1000,
+        .commandPeriod = 1.0,
+        .maxForce = 4,
+        .randomForces = 0,
+        .seed = 1,
+    };
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    const char *outputPath = "sweep.bin";
+
+    int opt, valid = 1;
+    while ((opt = getopt(argc, argv, "n:g:M:K:T:d:c:F:fs:j:o:")) != -1) {
+        switch (opt) {
+            case 'n':
+                sweep.simulations = atol(optarg); break;
+            case 'g':
+                sweep.grid = atoi(optarg); break;
+            case 'M':
+                valid &= parseRange(optarg, &sweep.ranges[0]); break;
+            case 'K':
+                valid &= parseRange(optarg, &sweep.ranges[1]); break;
+            case 'T':
+                valid &= parseRange(optarg, &sweep.ranges[2]); break;
+            case 'd':
+                sweep.duration = atof(optarg); break;
+            case 'c':
+                sweep.commandPeriod = atof(optarg); break;
+            case 'F':
+                sweep.maxForce = atoi(optarg); break;
+            case 'f':
+                sweep.randomForces = 1; break;
+            case 's':
+                sweep.seed = strtoull(optarg, NULL, 10); break;
+            case 'j':
+                threads = atoi(optarg); break;
+            case 'o':
+                outputPath = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-n runs] [-g grid points] [-M lo:hi] [-K lo:hi] [-T lo:hi] [-d seconds]\n"
+                        "       [-c command period] [-F max force] [-f] [-s seed] [-j threads] [-o output]\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (!valid || sweep.simulations < 1 || sweep.grid < 0 || sweep.duration <= 0 || sweep.maxForce < 1 || threads < 1) {
+        fprintf(stderr, "ranges, runs, duration, max force and threads must be positive\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < columnCount; i++) {
+        sweep.columns[i] = malloc(sweep.simulations * sizeof(union SweepValue));
+        if (sweep.columns[i] == NULL) {
+            perror("column allocation");
+            exit(EXIT_FAILURE);
+        }
+    }
+    atomic_init(&sweep.next, 0);
+
+    double start = nowSeconds();
+    pthread_t workers[threads];
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&workers[i], NULL, worker, &sweep) != 0) {
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (int i = 0; i < threads; i++) {
+        void *done;
+        pthread_join(workers[i], &done);
+        printf("worker %d: %ld runs\n", i, (long)done);
+    }
+    double elapsed = nowSeconds() - start;
+
+    double simulated = 0, steps = 0;
+    for (long run = 0; run < sweep.simulations; run++) {
+        steps += sweep.columns[colSteps][run].count;
+        simulated += sweep.columns[colSteps][run].count * sweep.columns[colStep][run].real;
+    }
+    printf("%ld runs, %.0f simulated seconds (%.0f steps) in %.3f s on %d threads: %.3g simulated s/s, %.1f ns per step\n",
+           sweep.simulations, simulated, steps, elapsed, threads, simulated / elapsed, elapsed * 1e9 * threads / steps);
+
+    if (writeColumns(outputPath, &sweep) == -1) {
+        perror("Error writing sweep output");
+        exit(EXIT_FAILURE);
+    }
+    printf("%d columns written to %s\n", columnCount, outputPath);
+
+    for (int i = 0; i < columnCount; i++) {
+        free(sweep.columns[i]);
+    }
+    return 0;
+}
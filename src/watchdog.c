@@ -10,16 +10,128 @@
 #include <signal.h>
 #include <sys/types.h>
 #include <time.h>  
+#include <errno.h>
+#include <fcntl.h>
 #include "../include/constant.h"
+#include "../include/supervision.h"
+#include "../include/virtualClock.h"
+#include "../include/shard.h"
+
+int serverCounter, windowCounter, keyboardCounter;
+pid_t serverPID, windowPID, keyboardPID, watchdogPID, pidKB;
+// One droneDynamics per shard (a single one when the board is not sharded)
+int droneShards;
+pid_t dronePIDs[maxShards];
+int droneCounters[maxShards];
+struct LaunchOptions launchOptions;
+struct VirtualClock *virtualClock;
+
+// Appending a timestamped line to the watchdog log
+void logEvent(const char *message, const char *name, pid_t pid) {
+    FILE *logFile = fopen("log/watchdogLog.txt", "a");
+    if (logFile == NULL) {
+        perror("Error opening log file");
+        exit(EXIT_FAILURE);
+    }
+
+    time_t rawtime;
+    char buffer[80];
+    time(&rawtime);
+    strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", localtime(&rawtime));
+    fprintf(logFile, "[%s] %s %s(%d)\n", buffer, message, name, pid);
+    fflush(logFile);
+    fclose(logFile);
+}
+
+// Pause between two pings. With the virtual clock it lasts until the simulation has advanced by the same
+// amount, so the deadlines (counterThresold cycles) are counted in simulated time; it is never shorter than
+// watchdogMinPauseUs, which keeps a fast clock from turning the pings into a signal storm, and never longer
+// than the wall-clock pause, which still catches a clock that has stopped
+void watchdogPause(long us) {
+    if (virtualClock == NULL) {
+        usleep(us);
+        return;
+    }
+    long long wallStart = monotonicNs(), simStart = clockNow(virtualClock);
+    usleep(watchdogMinPauseUs);
+    while (clockNow(virtualClock) - simStart < us * 1000LL && monotonicNs() - wallStart < us * 1000LL) {
+        usleep(watchdogMinPauseUs);
+    }
+}
 
-int serverCounter, windowCounter, keyboardCounter, droneCounter;
-pid_t serverPID, windowPID, keyboardPID, dronePID, watchdogPID, pidKB;
+// Sending the heartbeat request; in supervision mode a process that is already gone is being restarted by master
+void pingProcess(pid_t pid, const char *name) {
+    if (kill(pid, SIGUSR1) == -1) {
+        if (launchOptions.supervise && errno == ESRCH) {
+            return;
+        }
+        char message[maxMsgLength];
+        snprintf(message, sizeof(message), "kill %s", name);
+        perror(message);
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Picking up the PID of a restarted component; the latest PID is written back so that a
+// restarted watchdog can read it again from the same pipe
+void refreshPID(int pipeRead, int pipeWrite, pid_t *pid, int *counter, const char *name) {
+    pid_t newPID;
+    int changed = 0;
+    while (read(pipeRead, &newPID, sizeof(newPID)) == sizeof(newPID)) {
+        if (newPID != *pid) {
+            changed = 1;
+        }
+        *pid = newPID;
+    }
+    if (write(pipeWrite, pid, sizeof(*pid)) == -1) {
+        perror("write watchdog pipe");
+    }
+    if (changed) {
+        *counter = 0;
+        logEvent("Reattached restarted process", name, *pid);
+    }
+}
+
+// Picking up the PIDs of restarted shards, then writing every shard's latest PID back for a restarted watchdog
+void refreshDronePIDs(int pipeRead, int pipeWrite) {
+    struct DronePID entry;
+    while (read(pipeRead, &entry, sizeof(entry)) == sizeof(entry)) {
+        if (entry.shard < 0 || entry.shard >= droneShards || entry.pid == dronePIDs[entry.shard]) {
+            continue;
+        }
+        dronePIDs[entry.shard] = entry.pid;
+        droneCounters[entry.shard] = 0;
+        logEvent("Reattached restarted process", "DroneDynamics", entry.pid);
+    }
+    for (int shard = 0; shard < droneShards; shard++) {
+        entry = (struct DronePID){shard, dronePIDs[shard]};
+        if (write(pipeWrite, &entry, sizeof(entry)) == -1) {
+            perror("write watchdog pipe");
+        }
+    }
+}
+
+// Killing an unresponsive process so that master restarts it, instead of terminating everything
+void restartHung(pid_t pid, int *counter, const char *name) {
+    if (*counter <= counterThresold) {
+        return;
+    }
+    kill(pid, SIGKILL);
+    *counter = 0;
+    logEvent("Killed unresponsive process for restart:", name, pid);
+}
 
 // Function to terminate all processes and log the event
 void TerminateAll() {
+    // In supervision mode master must not restart the processes terminated here
+    if (launchOptions.supervise && launchOptions.masterPID > 0) {
+        kill(launchOptions.masterPID, SIGTERM);
+    }
     kill(serverPID, SIGINT);
     kill(windowPID, SIGINT);
-    kill(dronePID, SIGINT);
+    for (int shard = 0; shard < droneShards; shard++) {
+        kill(dronePIDs[shard], SIGINT);
+    }
     kill(pidKB, SIGINT);
     kill(keyboardPID, SIGINT);
 
@@ -93,9 +205,11 @@ void handler_Signal(int signo, siginfo_t *siginfo, void *context) {
             printf("Sent signal from keyboardManager\n");
             keyboardCounter = 0;
         }
-        if (siginfo->si_pid == dronePID) {
-            printf("Sent signal from droneDynamics\n");
-            droneCounter = 0;
+        for (int shard = 0; shard < droneShards; shard++) {
+            if (siginfo->si_pid == dronePIDs[shard]) {
+                printf("Sent signal from droneDynamics\n");
+                droneCounters[shard] = 0;
+            }
         }
     }
 }
@@ -103,31 +217,63 @@ void handler_Signal(int signo, siginfo_t *siginfo, void *context) {
 int main(int argc, char *argv[]) {
     // Pipes
     int pipeWatchdogServer[2], pipeWatchdogWindow[2], pipeWatchdogDrone[2], pipeWatchdogKeyboard[2];
-    serverCounter = windowCounter = droneCounter = keyboardCounter = 0;
+    serverCounter = windowCounter = keyboardCounter = 0;
 
     // Get PID from all other processes
     sscanf(argv[1], "%d %d|%d %d|%d %d|%d %d|%d", &pipeWatchdogServer[0], &pipeWatchdogServer[1], &pipeWatchdogWindow[0], &pipeWatchdogWindow[1], &pipeWatchdogKeyboard[0], &pipeWatchdogKeyboard[1], &pipeWatchdogDrone[0], &pipeWatchdogDrone[1], &pidKB);
-    close(pipeWatchdogServer[1]);
-    close(pipeWatchdogDrone[1]);
-    close(pipeWatchdogKeyboard[1]);
-    close(pipeWatchdogWindow[1]);
+    parseLaunchOptions(argc, argv, &launchOptions);
+
+    // In supervision mode the pipes stay open to receive the PIDs of restarted processes
+    if (!launchOptions.supervise) {
+        close(pipeWatchdogServer[1]);
+        close(pipeWatchdogDrone[1]);
+        close(pipeWatchdogKeyboard[1]);
+        close(pipeWatchdogWindow[1]);
+    }
 
     watchdogPID = getpid();
-    read(pipeWatchdogDrone[0], &dronePID, sizeof(dronePID));
+    // Every shard registers once it has started, in any order
+    droneShards = launchOptions.shards < 1 ? 1 : (launchOptions.shards > maxShards ? maxShards : launchOptions.shards);
+    for (int registered = 0; registered < droneShards;) {
+        struct DronePID entry;
+        if (read(pipeWatchdogDrone[0], &entry, sizeof(entry)) != sizeof(entry)) {
+            break;
+        }
+        if (entry.shard >= 0 && entry.shard < droneShards) {
+            registered += dronePIDs[entry.shard] == 0;
+            dronePIDs[entry.shard] = entry.pid;
+        }
+    }
     read(pipeWatchdogKeyboard[0], &keyboardPID, sizeof(keyboardPID));
     read(pipeWatchdogWindow[0], &windowPID, sizeof(windowPID));
     read(pipeWatchdogServer[0], &serverPID, sizeof(serverPID));
 
     printf("window: %d\n", windowPID);
     printf("server: %d\n", serverPID);
-    printf("droneDynamics: %d\n", dronePID);
+    for (int shard = 0; shard < droneShards; shard++) {
+        printf("droneDynamics shard %d: %d\n", shard, dronePIDs[shard]);
+    }
     printf("keyboardManager: %d\n", keyboardPID);
     printf("watchdog: %d\n", watchdogPID);
 
-    close(pipeWatchdogServer[0]);
-    close(pipeWatchdogDrone[0]);
-    close(pipeWatchdogKeyboard[0]);
-    close(pipeWatchdogWindow[0]);  // Closing unnecessary pipes
+    if (launchOptions.supervise) {
+        int pipes[4][2] = {{pipeWatchdogServer[0], pipeWatchdogServer[1]}, {pipeWatchdogWindow[0], pipeWatchdogWindow[1]},
+                           {pipeWatchdogKeyboard[0], pipeWatchdogKeyboard[1]}, {pipeWatchdogDrone[0], pipeWatchdogDrone[1]}};
+        pid_t *pids[3] = {&serverPID, &windowPID, &keyboardPID};
+        for (int i = 0; i < 4; i++) {
+            int flags = fcntl(pipes[i][0], F_GETFL);
+            fcntl(pipes[i][0], F_SETFL, flags | O_NONBLOCK);
+            if (i < 3) {
+                write(pipes[i][1], pids[i], sizeof(pid_t));
+            }
+        }
+        refreshDronePIDs(pipeWatchdogDrone[0], pipeWatchdogDrone[1]);
+    } else {
+        close(pipeWatchdogServer[0]);
+        close(pipeWatchdogDrone[0]);
+        close(pipeWatchdogKeyboard[0]);
+        close(pipeWatchdogWindow[0]);  // Closing unnecessary pipes
+    }
 
     // Signal handling
     struct sigaction sig_act;
@@ -147,39 +293,53 @@ int main(int argc, char *argv[]) {
         exit(EXIT_FAILURE);
     }
 
+    logRecovery(logFile, "Watchdog", &launchOptions);
+    if (launchOptions.virtualClock) {
+        virtualClock = clockAttach();
+        if (virtualClock == NULL) {
+            perror("virtual clock");
+            exit(EXIT_FAILURE);
+        }
+    }
+
     while (1) {
+        if (launchOptions.supervise) {
+            refreshPID(pipeWatchdogServer[0], pipeWatchdogServer[1], &serverPID, &serverCounter, "Server");
+            refreshPID(pipeWatchdogWindow[0], pipeWatchdogWindow[1], &windowPID, &windowCounter, "Window");
+            refreshPID(pipeWatchdogKeyboard[0], pipeWatchdogKeyboard[1], &keyboardPID, &keyboardCounter, "KeyboardManager");
+            refreshDronePIDs(pipeWatchdogDrone[0], pipeWatchdogDrone[1]);
+        }
+
         serverCounter++;
         windowCounter++;
-        droneCounter++;
         keyboardCounter++;
+        for (int shard = 0; shard < droneShards; shard++) {
+            droneCounters[shard]++;
+        }
 
         // Sending signals to other processes
-        if (kill(serverPID, SIGUSR1) == -1) {
-            perror("kill server");
-            exit(EXIT_FAILURE);
-        }
-        usleep(50000);
+        pingProcess(serverPID, "server");
+        watchdogPause(50000);
 
-        if (kill(windowPID, SIGUSR1) == -1) {
-            perror("kill window");
-            exit(EXIT_FAILURE);
-        }
-        usleep(50000);
+        pingProcess(windowPID, "window");
+        watchdogPause(50000);
 
-        if (kill(keyboardPID, SIGUSR1) == -1) {
-            perror("kill keyboardManager");
-            exit(EXIT_FAILURE);
-        }
-        usleep(50000);
+        pingProcess(keyboardPID, "keyboardManager");
+        watchdogPause(50000);
 
-        usleep(50000);
-        usleep(50000);
+        watchdogPause(50000);
+        watchdogPause(50000);
 
-        if (kill(dronePID, SIGUSR1) == -1) {
-            perror("kill droneDynamics");
-            exit(EXIT_FAILURE);
+        // One shard at a time: replies that arrive while another SIGUSR2 is pending would be merged with it
+        for (int shard = 0; shard < droneShards; shard++) {
+            pingProcess(dronePIDs[shard], "droneDynamics");
+            watchdogPause(50000);
+        }
+
+        int droneCounter = 0; // the least responsive shard
+        for (int shard = 0; shard < droneShards; shard++) {
+            droneCounter = droneCounters[shard] > droneCounter ? droneCounters[shard] : droneCounter;
         }
-        usleep(50000);
 
         // Logging the sent signals
         time_t rawtime;
@@ -194,6 +354,17 @@ int main(int argc, char *argv[]) {
                 buffer, serverCounter, windowCounter, keyboardCounter, droneCounter);
         fflush(logFile);
 
+        // In supervision mode only the unresponsive process is killed, master restarts it
+        if (launchOptions.supervise) {
+            restartHung(serverPID, &serverCounter, "Server");
+            restartHung(windowPID, &windowCounter, "Window");
+            restartHung(keyboardPID, &keyboardCounter, "KeyboardManager");
+            for (int shard = 0; shard < droneShards; shard++) {
+                restartHung(dronePIDs[shard], &droneCounters[shard], "DroneDynamics");
+            }
+            continue;
+        }
+
         if (serverCounter > counterThresold || windowCounter > counterThresold || droneCounter > counterThresold || keyboardCounter > counterThresold) {
             watchdogPID = getpid();
             TerminateAll();
@@ -15,6 +15,17 @@
 #include <signal.h>
 #include <time.h>
 #include "../include/constant.h"
+#include "../include/supervision.h"
+#include "../include/droneModel.h"
+#include "../include/checkpoint.h"
+#include "../include/densityRenderer.h"
+#include "../include/perfProfile.h"
+#include "../include/sharedState.h"
+#include "../include/world.h"
+#include "../include/shard.h"
+
+// Color pairs of the world, after the density levels
+#define WORLD_COLOR_PAIR (DENSITY_COLOR_PAIR + densityLevels)
 
 // Function for creating a new window
 WINDOW *createBoard(int height, int width, int starty, int startx)
@@ -69,11 +80,42 @@ void setupNcursesWindows(WINDOW **display, WINDOW **scoreboard)
     *display = createBoard(displayHeight, displayWidth, inPos[0], inPos[1]);
 }
 
+// Function for drawing the obstacles ('#') and targets ('X') of the world, or blanking them when erase is set;
+// cells holding a drone are left to the density renderer
+void drawWorld(WINDOW *win, struct DensityRenderer *renderer, const struct WorldItem *items, int count, int erase)
+{
+    for (int i = 0; i < count; i++)
+    {
+        int col0 = (int)(items[i].x0 / renderer->scalex) - 1, col1 = (int)(items[i].x1 / renderer->scalex) - 1;
+        int row0 = (int)(items[i].y0 / renderer->scaley) - 1, row1 = (int)(items[i].y1 / renderer->scaley) - 1;
+        col0 = col0 < 0 ? 0 : col0;
+        row0 = row0 < 0 ? 0 : row0;
+        col1 = col1 >= renderer->cols ? renderer->cols - 1 : col1;
+        row1 = row1 >= renderer->rows ? renderer->rows - 1 : row1;
+
+        chtype glyph = ' ';
+        if (!erase)
+        {
+            glyph = items[i].kind == worldObstacle ? '#' | COLOR_PAIR(WORLD_COLOR_PAIR) : 'X' | COLOR_PAIR(WORLD_COLOR_PAIR + 1);
+        }
+        for (int row = row0; row <= row1; row++)
+        {
+            for (int col = col0; col <= col1; col++)
+            {
+                if (renderer->previous[row * renderer->cols + col] == 0)
+                {
+                    mvwaddch(win, row + 1, col + 1, glyph);
+                }
+            }
+        }
+    }
+}
+
 // Function to logging data to a file
-void logData(FILE *logFile, double *position, int sharedSegSize)
+void logData(FILE *logFile, positionReal *position, int sharedSegSize)
 {
     fprintf(logFile, "Current Position:  %.2f, %.2f\n",
-            position[4], position[5]);
+            positionToDouble(position[4]), positionToDouble(position[5]));
     fflush(logFile);
 }
 
@@ -114,8 +156,12 @@ int main(int argc, char *argv[])
     printf("%d\n", windowPID);
     close(pipeWatchdogWindow[1]);
 
+    struct LaunchOptions launchOptions;
+    parseLaunchOptions(argc, argv, &launchOptions);
+
     // Shared memory setup
-    double position[6] = {boardSize / 2, boardSize / 2, boardSize / 2, boardSize / 2, boardSize / 2, boardSize / 2};
+    positionReal center = positionFromDouble(boardSize / 2);
+    positionReal position[6] = {center, center, center, center, center, center};
     int sharedSegSize = (sizeof(position));
 
     sem_t *semID = sem_open(SEM_PATH, 0);
@@ -130,18 +176,21 @@ int main(int argc, char *argv[])
         perror("shm_open");
         exit(EXIT_FAILURE);
     }
-    void *shmPointer = mmap(NULL, sharedSegSize, PROT_READ | PROT_WRITE, MAP_SHARED, shmfd, 0);
+    void *shmPointer = mmap(NULL, SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, shmfd, 0);
     if (shmPointer == MAP_FAILED)
     {
         perror("mmap");
         exit(EXIT_FAILURE);
     }
+    struct SharedState *sharedState = shmPointer;
+    unsigned generation = stateGeneration(sharedState);
+    long long lastFrame = 0;
 
     // Open the log file
     FILE *logFile;
     char logFilePath[100];
     snprintf(logFilePath, sizeof(logFilePath), "log/windowLog.txt");
-    logFile = fopen(logFilePath, "w");
+    logFile = fopen(logFilePath, launchOptions.restartedAt ? "a" : "w");
 
     if (logFile == NULL)
     {
@@ -149,18 +198,87 @@ int main(int argc, char *argv[])
         exit(EXIT_FAILURE);
     }
 
+    // A restarted window shows the current state instead of resetting the drone to the centre
+    if (launchOptions.restartedAt)
+    {
+        sem_wait(semID);
+        memcpy(position, shmPointer, sharedSegSize);
+        sem_post(semID);
+        initial = 1;
+    }
+    logRecovery(logFile, "Window", &launchOptions);
+
+    // Starting from the checkpointed position instead of the centre of the board
+    struct CheckpointSlot restored;
+    if (launchOptions.restore && !launchOptions.restartedAt && checkpointRestore(CHECKPOINT_PATH, &restored))
+    {
+        memcpy(position, restored.position, sizeof(position));
+    }
+
+    // Drawing windows; they are rebuilt only when the terminal size changes
+    WINDOW *win = NULL, *scoreboard = NULL;
+    struct DensityRenderer renderer = {0};
+    int lines = 0, cols = 0;
+    densityColors();
+    init_pair(WORLD_COLOR_PAIR, COLOR_WHITE, COLOR_BLACK);
+    init_pair(WORLD_COLOR_PAIR + 1, COLOR_GREEN, COLOR_BLACK);
+    curs_set(0);
+
+    // Obstacles and targets kept by server, copied again only when their version changes; the copy goes
+    // to a spare buffer so that a failed one keeps the last good world on the screen
+    static struct WorldItem worldBuffers[2][worldMaxItems];
+    struct WorldItem *worldItems = worldBuffers[0];
+    struct ArenaHeader *worldArena = NULL;
+    unsigned worldSeen = 0;
+    int worldCount = 0;
+
+    // With a sharded board (./bin/master -n) the whole swarm is drawn straight from the shard regions
+    struct ShardSegment *shardSegment = NULL;
+    if (launchOptions.shards > 1)
+    {
+        shardSegment = shardAttach();
+        if (shardSegment == NULL)
+        {
+            perror("shard segment");
+        }
+    }
+
+    PROFILE_DECLARE(frameProfile);
+    PROFILE_OPEN(frameProfile, logFile, "window", "frame");
+
     while (1)
     {
-        // Refreshing windows
-        WINDOW *win, *scoreboard;
-        setupNcursesWindows(&win, &scoreboard);
-        curs_set(0);
-        nodelay(win, TRUE);
+        PROFILE_BEGIN(frameProfile);
+        if (win == NULL || lines != LINES || cols != COLS)
+        {
+            if (win != NULL)
+            {
+                delwin(win);
+                delwin(scoreboard);
+                densityFree(&renderer);
+                clear();
+                refresh();
+            }
+            lines = LINES;
+            cols = COLS;
+            setupNcursesWindows(&win, &scoreboard);
+            nodelay(win, TRUE);
+            keypad(win, TRUE);
 
-        double scalex, scaley;
+            double scalex, scaley;
 
-        scalex = (double)boardSize / ((double)COLS * (windowWidth - 0.1));
-        scaley = (double)boardSize / ((double)LINES * (windowHeight - 0.1));
+            scalex = (double)boardSize / ((double)COLS * (windowWidth - 0.1));
+            scaley = (double)boardSize / ((double)LINES * (windowHeight - 0.1));
+
+            // Interior of the board, inside the borders drawn by createBoard
+            int displayHeight = LINES * windowHeight;
+            int displayWidth = COLS * windowWidth;
+            if (densityInit(&renderer, (int)(displayHeight * 0.9) - 1, (int)(displayWidth * 0.9) - 1, scalex, scaley) == -1)
+            {
+                perror("densityInit");
+                exit(EXIT_FAILURE);
+            }
+        }
 
         // Sending the first drone position to drone.c via shared memory
         if (initial == 0)
@@ -168,21 +286,56 @@ int main(int argc, char *argv[])
             sem_wait(semID);
             memcpy(shmPointer, position, sharedSegSize);
             sem_post(semID);
+            statePublish(sharedState);
 
             initial++;
         }
 
-        // Showing the drone and position in the konsole
-        wattron(win, COLOR_PAIR(2));
-        mvwprintw(win, (int)(position[5] / scaley), (int)(position[4] / scalex), "+");
-        wattroff(win, COLOR_PAIR(2));
+        // Showing the drones and position in the konsole: rasterize the published state, or every shard's
+        // drones (the keyboard drone among them), then draw only changed cells
+        if (shardSegment != NULL)
+        {
+            densityClear(&renderer);
+            for (int shard = 0; shard < shardSegment->shardCount; shard++)
+            {
+                struct ShardRegion *region = &shardSegment->regions[shard];
+                int count = region->count; // the owning shard keeps changing it, a frame may be one tick off
+                count = count < 0 ? 0 : (count > shardCapacity ? shardCapacity : count);
+                densityAdd(&renderer, region->drones[0].position + 4, count, swarmStride);
+            }
+        }
+        else
+        {
+            densityRasterize(&renderer, position + 4, 1, 6);
+        }
+        densityPresent(&renderer, win);
+
+        // Drawing the world over the empty cells, after blanking the previous one if server changed it
+        if (worldArena == NULL)
+        {
+            worldArena = arenaAttach(WORLD_SHM_PATH, 0);
+        }
+        if (worldArena != NULL && worldVersion(worldArena) != worldSeen)
+        {
+            struct WorldItem *spare = worldItems == worldBuffers[0] ? worldBuffers[1] : worldBuffers[0];
+            int count = worldSnapshot(worldArena, spare, worldMaxItems, &worldSeen);
+            if (count >= 0)
+            {
+                drawWorld(win, &renderer, worldItems, worldCount, 1);
+                worldItems = spare;
+                worldCount = count;
+            }
+        }
+        drawWorld(win, &renderer, worldItems, worldCount, 0);
 
         wattron(scoreboard, COLOR_PAIR(1));
-        mvwprintw(scoreboard, 1, 1, "Position of the drone: %.2f,%.2f", position[4], position[5]);
+        mvwprintw(scoreboard, 1, 1, "Position of the drone: %6.2f,%6.2f", positionToDouble(position[4]), positionToDouble(position[5]));
         wattroff(scoreboard, COLOR_PAIR(1));
 
-        wrefresh(win);
-        wrefresh(scoreboard);
+        wnoutrefresh(win);
+        wnoutrefresh(scoreboard);
+        doupdate();
+        PROFILE_END(frameProfile);
         noecho();
 
         // Sending user input to keyboardManager.c
@@ -203,7 +356,15 @@ int main(int argc, char *argv[])
                 exit(EXIT_SUCCESS);
             }
         }
-        usleep(200000);
+
+        // Frame rate cap, then sleeping until the drone publishes a new state or the keys are due
+        stateRateLimit(&lastFrame, windowFrameIntervalUs);
+        unsigned seen = generation;
+        generation = stateWait(sharedState, seen, windowKeyPollUs);
+        if (generation == seen)
+        {
+            continue;
+        }
 
         // Reading from shared memory
         sem_wait(semID);
@@ -212,11 +373,10 @@ int main(int argc, char *argv[])
 
         // Writing to the log file
         logData(logFile, position, sharedSegSize);
-        clear();
-        sleep(1);
     }
 
     // Cleaning up
+    densityFree(&renderer);
     shm_unlink(SHM_PATH);
     sem_close(semID);
     sem_unlink(SEM_PATH);